@@ -0,0 +1,109 @@
+#include "AnalysisCache.h"
+#include "Varint.h"
+#include <QDataStream>
+#include <QDir>
+#include <QMutex>
+#include <algorithm>
+#include <cstring>
+
+namespace {
+const quint32 CacheMagic = 0x494E4341; // "INCA"
+// Bump whenever TokenCloneDetector::tokenize() produces different tokens
+const quint32 CacheVersion = 1;
+// Held from reading the cache to replacing it in update()
+QMutex updateMutex;
+}
+
+AnalysisCache::AnalysisCache(const QString &projectPath)
+    : projectPath(projectPath), file(projectPath, "analysis.cache", CacheMagic, CacheVersion, "analysis cache")
+{
+}
+
+QString AnalysisCache::cacheFilePath() const
+{
+    return file.filePath();
+}
+
+bool AnalysisCache::load(QHash<QString, AnalyzedFile> &files) const
+{
+    files.clear();
+    const QDir root(projectPath);
+    const bool ok = file.read([&](QDataStream &in) {
+        quint32 fileCount = 0;
+        in >> fileCount;
+        files.reserve(fileCount);
+        for (quint32 i = 0; i < fileCount && in.status() == QDataStream::Ok; ++i) {
+            QByteArray relativePath;
+            QByteArray tokens;
+            QByteArray lines;
+            AnalyzedFile entry;
+            in >> relativePath >> entry.modified >> entry.size >> entry.contentHash >> tokens >> lines;
+            entry.filePath = root.absoluteFilePath(QString::fromUtf8(relativePath));
+
+            // Token codes are stored raw in native byte order, lines as varint deltas
+            const int tokenCount = int(tokens.size() / qsizetype(sizeof(quint32)));
+            entry.tokens.tokens.resize(tokenCount);
+            std::memcpy(entry.tokens.tokens.data(), tokens.constData(), size_t(tokenCount) * sizeof(quint32));
+            entry.tokens.lines.reserve(tokenCount);
+            const char *pos = lines.constData();
+            const char *end = pos + lines.size();
+            int line = 0;
+            for (int t = 0; t < tokenCount; ++t) {
+                line += int(readVarint(pos, end));
+                entry.tokens.lines.append(line);
+            }
+            files.insert(entry.filePath, entry);
+        }
+    });
+    if (!ok) {
+        files.clear();
+    }
+    return ok;
+}
+
+bool AnalysisCache::save(const QHash<QString, AnalyzedFile> &files) const
+{
+    const QDir root(projectPath);
+    return file.write([&](QDataStream &out) {
+        out << quint32(files.size());
+        for (const AnalyzedFile &entry : files) {
+            const QByteArray tokens = QByteArray::fromRawData(reinterpret_cast<const char *>(entry.tokens.tokens.constData()),
+                                                              entry.tokens.tokens.size() * qsizetype(sizeof(quint32)));
+            QByteArray lines;
+            lines.reserve(entry.tokens.lines.size());
+            int previousLine = 0;
+            for (int line : entry.tokens.lines) {
+                appendVarint(lines, quint32(line - previousLine));
+                previousLine = line;
+            }
+            out << root.relativeFilePath(entry.filePath).toUtf8()
+                << entry.modified << entry.size << entry.contentHash << tokens << lines;
+        }
+    });
+}
+
+bool AnalysisCache::update(const QHash<QString, AnalyzedFile> &files, const QStringList &directories) const
+{
+    QMutexLocker locker(&updateMutex);
+    QHash<QString, AnalyzedFile> merged;
+    load(merged);
+
+    QStringList prefixes;
+    for (const QString &directory : directories) {
+        prefixes.append(QDir::cleanPath(QDir(projectPath).filePath(directory)) + '/');
+    }
+    for (auto it = merged.begin(); it != merged.end();) {
+        const bool covered = prefixes.isEmpty() || std::any_of(prefixes.cbegin(), prefixes.cend(), [&it](const QString &prefix) {
+            return it.key().startsWith(prefix);
+        });
+        // Covered files that weren't scanned were deleted or are ignored now
+        if (covered && !files.contains(it.key()))
+            it = merged.erase(it);
+        else
+            ++it;
+    }
+    for (auto it = files.cbegin(); it != files.cend(); ++it) {
+        merged.insert(it.key(), it.value());
+    }
+    return save(merged);
+}
@@ -0,0 +1,52 @@
+#ifndef INCODE_ANALYSISCACHE_H
+#define INCODE_ANALYSISCACHE_H
+
+#include "TokenCloneDetector.h"
+#include "CacheFile.h"
+#include <QString>
+#include <QByteArray>
+#include <QHash>
+#include <QStringList>
+
+// Everything the analyzer keeps about one file between runs. As with the
+// symbol index, modification time and size are the cheap first check and
+// the content hash catches files that were touched but not changed.
+struct AnalyzedFile {
+    QString filePath;
+    qint64 modified = 0; // msecs since epoch
+    qint64 size = -1;
+    QByteArray contentHash;
+    TokenCloneDetector::FileTokens tokens;
+};
+
+// Persists per-file token streams to <project>/.incode/analysis.cache so a
+// rerun only re-tokenizes changed files; clone classes are always
+// recomputed from the streams.
+class AnalysisCache
+{
+public:
+    explicit AnalysisCache(const QString &projectPath);
+
+    QString cacheFilePath() const;
+
+    // Reads a previously saved cache (memory-mapped). Returns false and
+    // leaves files empty if there is none or it was written by another
+    // version.
+    bool load(QHash<QString, AnalyzedFile> &files) const;
+
+    // Replaces the cached files below directories (anywhere in the project
+    // if empty) with files and keeps the others. The indexer and the
+    // analyzer both bring the cache up to date for the folders they scan;
+    // updates are serialized, and as each one reloads the cache first,
+    // neither drops what the other wrote.
+    bool update(const QHash<QString, AnalyzedFile> &files, const QStringList &directories) const;
+
+private:
+    // Atomically replaces the cache file with the given entries
+    bool save(const QHash<QString, AnalyzedFile> &files) const;
+
+    QString projectPath;
+    CacheFile file;
+};
+
+#endif // INCODE_ANALYSISCACHE_H
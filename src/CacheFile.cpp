@@ -0,0 +1,72 @@
+#include "CacheFile.h"
+#include <QFile>
+#include <QSaveFile>
+#include <QDir>
+#include <QDebug>
+
+CacheFile::CacheFile(const QString &projectPath, const QString &fileName, quint32 magic, quint32 version,
+                     const char *description)
+    : projectPath(projectPath), fileName(fileName), magic(magic), version(version), description(description)
+{
+}
+
+QString CacheFile::filePath() const
+{
+    return QDir(projectPath).filePath(".incode/" + fileName);
+}
+
+bool CacheFile::read(const Reader &reader) const
+{
+    QFile file(filePath());
+    if (!file.open(QIODevice::ReadOnly) || file.size() == 0) {
+        return false;
+    }
+
+    uchar *mapped = file.map(0, file.size());
+    if (!mapped) {
+        qWarning() << "Could not map" << description << file.fileName();
+        return false;
+    }
+
+    // fromRawData does not copy: the stream reads straight from the mapping
+    const QByteArray data = QByteArray::fromRawData(reinterpret_cast<const char *>(mapped), file.size());
+    QDataStream in(data);
+    in.setVersion(QDataStream::Qt_6_0);
+
+    quint32 fileMagic = 0;
+    quint32 fileVersion = 0;
+    in >> fileMagic >> fileVersion;
+    if (in.status() != QDataStream::Ok || fileMagic != magic || fileVersion != version) {
+        file.unmap(mapped);
+        return false;
+    }
+
+    reader(in);
+    const bool ok = in.status() == QDataStream::Ok;
+    file.unmap(mapped);
+    if (!ok) {
+        qWarning() << "Discarding corrupt" << description << file.fileName();
+    }
+    return ok;
+}
+
+bool CacheFile::write(const Writer &writer) const
+{
+    if (!QDir(projectPath).mkpath(".incode")) {
+        qWarning() << "Could not create cache directory in" << projectPath;
+        return false;
+    }
+
+    QSaveFile file(filePath());
+    if (!file.open(QIODevice::WriteOnly)) {
+        qWarning() << "Could not write" << description << file.fileName();
+        return false;
+    }
+
+    QDataStream out(&file);
+    out.setVersion(QDataStream::Qt_6_0);
+    out << magic << version;
+    writer(out);
+
+    return file.commit();
+}
@@ -0,0 +1,39 @@
+#ifndef INCODE_CACHEFILE_H
+#define INCODE_CACHEFILE_H
+
+#include <QString>
+#include <QDataStream>
+#include <functional>
+
+// A file in <project>/.incode: a magic number and a format version, then
+// a QDataStream payload. Reading maps the file; writing replaces it
+// atomically, so readers never see half a file.
+class CacheFile
+{
+public:
+    using Reader = std::function<void(QDataStream &in)>;
+    using Writer = std::function<void(QDataStream &out)>;
+
+    // description names the file in warnings ("symbol cache")
+    CacheFile(const QString &projectPath, const QString &fileName, quint32 magic, quint32 version,
+              const char *description);
+
+    QString filePath() const;
+
+    // Calls reader with the payload, straight from the mapping. Returns
+    // false if there is no file, it was written by another version or
+    // the payload ended early; reader's results must then be discarded.
+    bool read(const Reader &reader) const;
+
+    // Writes the header and whatever writer streams after it
+    bool write(const Writer &writer) const;
+
+private:
+    QString projectPath;
+    QString fileName;
+    quint32 magic;
+    quint32 version;
+    const char *description;
+};
+
+#endif // INCODE_CACHEFILE_H
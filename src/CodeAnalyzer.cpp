@@ -1,89 +1,525 @@
 #include "CodeAnalyzer.h"
+#include "CacheFile.h"
 #include <QFile>
-#include <QTextStream>
-#include <QCryptographicHash>
-#include <QDirIterator>
+#include <QDir>
 #include <QDebug>
+#include <QThreadPool>
+#include <QThread>
+#include <QElapsedTimer>
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <algorithm>
+#include <utility>
+#include <cstring>
+
+namespace {
+
+const quint32 ResultsMagic = 0x494E4352; // "INCR"
+const quint32 ResultsVersion = 1;
+
+// The results of the last run of each mode
+CacheFile resultsFile(const QString &projectPath, CodeAnalyzer::AnalysisMode mode)
+{
+    return CacheFile(projectPath, mode == CodeAnalyzer::SimilarityAnalysis ? "similarity.cache" : "clones.cache",
+                     ResultsMagic, ResultsVersion, "analysis results");
+}
+
+QVector<qsizetype> lineStartsOf(const QByteArray &content)
+{
+    QVector<qsizetype> starts;
+    starts.append(0);
+    const char *data = content.constData();
+    const char *end = data + content.size();
+    for (const char *pos = data; (pos = static_cast<const char *>(std::memchr(pos, '\n', size_t(end - pos)))); ++pos) {
+        starts.append(pos - data + 1);
+    }
+    return starts;
+}
+
+// Original text of lines startLine..endLine, given the offsets where lines start
+QString snippetText(const QByteArray &content, const QVector<qsizetype> &lineStarts, int startLine, int endLine)
+{
+    if (startLine < 1 || endLine > lineStarts.size())
+        return QString();
+    const qsizetype begin = lineStarts.at(startLine - 1);
+    const qsizetype end = endLine < lineStarts.size() ? lineStarts.at(endLine) : content.size();
+    return QString::fromUtf8(content.constData() + begin, int(end - begin)).trimmed();
+}
+
+} // namespace
+
+CodeAnalyzer::CodeAnalyzer(QObject *parent) : QObject(parent), workerPool(new QThreadPool(this))
+{
+    workerPool->setMaxThreadCount(QThread::idealThreadCount());
+}
+
+void CodeAnalyzer::setThreadCount(int count)
+{
+    workerPool->setMaxThreadCount(count > 0 ? count : QThread::idealThreadCount());
+}
+
+int CodeAnalyzer::threadCount() const
+{
+    return workerPool->maxThreadCount();
+}
 
-CodeAnalyzer::CodeAnalyzer(QObject *parent) : QObject(parent)
+void CodeAnalyzer::setCacheEnabled(bool enabled)
 {
+    useCache = enabled;
 }
 
-void CodeAnalyzer::analyzePaths(const QList<QString> &paths)
+bool CodeAnalyzer::cacheEnabled() const
 {
-    detectedRepetitions.clear();
-    snippetHashes.clear();
+    return useCache;
+}
+
+void CodeAnalyzer::analyzePaths(const QList<QString> &paths, const QString &projectPath, AnalysisMode mode)
+{
+    pendingJobs.fetchAndAddOrdered(1);
+    const int job = currentJob.fetchAndAddOrdered(1) + 1;
+    emit startAnalysis(paths, projectPath, mode, job);
+}
 
-    qDebug() << "Starting code analysis for paths:" << paths;
+void CodeAnalyzer::cancelAnalysis()
+{
+    currentJob.fetchAndAddOrdered(1);
+}
 
-    for (const QString &path : paths) {
-        QDirIterator it(path, QStringList() << "*.php", QDir::Files | QDir::NoDotAndDotDot, QDirIterator::Subdirectories);
-        while (it.hasNext()) {
-            analyzeFile(it.next());
+void CodeAnalyzer::doAnalyzePaths(const QList<QString> &paths, const QString &projectPath, AnalysisMode mode, int job)
+{
+    // Superseded or cancelled while still queued
+    if (isCancelled(job)) {
+        abandonJob();
+        return;
+    }
+
+    releaseState();
+    qDebug() << "Starting code analysis for paths:" << paths << "mode:" << mode;
+    QElapsedTimer timer;
+    timer.start();
+
+    WalkStats walkStats;
+    const QVector<ScannedFile> files = ProjectScanner::walk(
+        paths, projectPath.isEmpty() ? IgnoreRules() : IgnoreRules::forProject(projectPath),
+        [this, job]() { return isCancelled(job); }, &walkStats);
+    if (isCancelled(job)) {
+        abandonJob();
+        return;
+    }
+
+    // Progress: tokenizing is the first 60%, detection the next 35%
+    QElapsedTimer sinceProgress;
+    sinceProgress.start();
+    int lastProgress = -1;
+    auto reportProgress = [&](int progress) {
+        if (progress != lastProgress && sinceProgress.elapsed() >= ProgressIntervalMsecs) {
+            lastProgress = progress;
+            sinceProgress.restart();
+            emit analysisProgress(progress);
         }
+    };
+
+    // Only files changed since the cache was written (for example by the
+    // indexer, which tokenizes while it reads) are read here
+    AnalysisScanConsumer consumer(paths, useCache);
+    ProjectScanner scanner(workerPool);
+    scanner.addConsumer(&consumer);
+    const bool completed = scanner.run(projectPath, files, [this, job]() { return isCancelled(job); },
+                                       [&](int filesDone, int filesTotal) {
+                                           reportProgress((filesDone * 60) / filesTotal);
+                                       });
+    if (!completed) {
+        qDebug() << "Code analysis cancelled after" << scanner.filesRead() << "of" << consumer.staleCount() << "files.";
+        abandonJob();
+        return;
     }
+    const int staleCount = consumer.staleCount();
+    QVector<AnalyzedFile> entries = consumer.takeEntries();
 
-    // Now, identify actual repetitions (snippets appearing more than once)
-    for (auto it = snippetHashes.constBegin(); it != snippetHashes.constEnd(); ++it) {
-        if (it.value().size() > 1) {
-            // This snippet appears multiple times, so it's a repetition
-            detectedRepetitions.append(it.value());
+    // Detection is global, so one changed file means running all of it
+    // again; with none changed, the last run's results still hold
+    const bool cacheResults = useCache && !projectPath.isEmpty();
+    const QByteArray fingerprint = fingerprintOf(entries, mode);
+    RepetitionResults cachedResults;
+    if (cacheResults && loadResults(projectPath, mode, fingerprint, cachedResults)) {
+        qDebug() << "Code analysis input unchanged, reusing the last results. Files:" << entries.size()
+                 << "groups:" << cachedResults.groupCount() << "elapsed ms:" << timer.elapsed();
+        releaseState();
+        pendingJobs.fetchAndAddOrdered(-1);
+        emit analysisFinished(cachedResults);
+        return;
+    }
+
+    // Feed the detector in walk order so results don't depend on thread
+    // timing, freeing each stream once it is copied
+    const int fileCount = entries.size();
+    for (AnalyzedFile &entry : entries) {
+        analyzedFiles.append(entry.filePath);
+        if (mode == SimilarityAnalysis)
+            similarityDetector.addFile(entry.tokens);
+        else
+            detector.addFile(entry.tokens);
+        entry.tokens = TokenCloneDetector::FileTokens();
+    }
+    entries = QVector<AnalyzedFile>();
+
+    if (mode == SimilarityAnalysis) {
+        qint64 skippedPairs = 0;
+        const QVector<NearDuplicateDetector::SimilarPair> pairs = similarityDetector.detect(MinSimilarity, [&](int progress) {
+            reportProgress(60 + (progress * 35) / 100);
+            return !isCancelled(job);
+        }, &skippedPairs);
+        if (isCancelled(job)) {
+            qDebug() << "Code analysis cancelled during similarity detection.";
+            abandonJob();
+            return;
         }
+
+        const RepetitionResults results = resultsOf(pairs);
+        if (cacheResults)
+            saveResults(projectPath, mode, fingerprint, results);
+
+        qDebug() << "Similarity analysis finished. Files:" << fileCount << "re-read:" << staleCount
+                 << "functions:" << similarityDetector.functions().size() << "similar pairs:" << pairs.size()
+                 << "pairs skipped in oversized buckets:" << skippedPairs
+                 << "elapsed ms:" << timer.elapsed() << "reported" << results.groupCount() << "pairs"
+                 << "in" << results.files.size() << "files, result bytes:" << results.memoryUsage();
+
+        releaseState();
+        pendingJobs.fetchAndAddOrdered(-1);
+        emit analysisFinished(results);
+        return;
+    }
+
+    // Candidates are shown as the walk finds them, the final list at the end
+    QVector<TokenCloneDetector::CloneClass> found;
+    QElapsedTimer sincePartial;
+    sincePartial.start();
+    auto reportFound = [&](const TokenCloneDetector::CloneClass &clone) {
+        found.append(clone);
+        if (sincePartial.elapsed() >= PartialResultsIntervalMsecs && !isCancelled(job)) {
+            sincePartial.restart();
+            emit partialResults(resultsOf(found));
+        }
+    };
+    const QVector<TokenCloneDetector::CloneClass> classes = detector.detect(MinCloneTokens, [&](int progress) {
+        reportProgress(60 + (progress * 35) / 100);
+        return !isCancelled(job);
+    }, reportFound);
+    found = QVector<TokenCloneDetector::CloneClass>();
+    if (isCancelled(job)) {
+        qDebug() << "Code analysis cancelled during clone detection.";
+        abandonJob();
+        return;
     }
 
-    qDebug() << "Code analysis finished. Found" << detectedRepetitions.size() << "repetitions.";
-    emit analysisFinished(detectedRepetitions);
+    const RepetitionResults results = resultsOf(classes);
+    if (cacheResults)
+        saveResults(projectPath, mode, fingerprint, results);
+
+    qDebug() << "Code analysis finished. Files:" << fileCount << "re-read:" << staleCount
+             << "ignored files:" << walkStats.ignoredFiles << "pruned directories:" << walkStats.prunedDirectories
+             << "tokens:" << detector.tokenCount()
+             << "clone classes:" << classes.size() << "threads:" << workerPool->maxThreadCount()
+             << "elapsed ms:" << timer.elapsed() << "found" << results.repetitions.size() << "repetitions"
+             << "in" << results.files.size() << "files, result bytes:" << results.memoryUsage();
+
+    releaseState();
+    pendingJobs.fetchAndAddOrdered(-1);
+    emit analysisFinished(results);
 }
 
-void CodeAnalyzer::analyzeFile(const QString &filePath)
+void CodeAnalyzer::releaseState()
 {
-    QFile file(filePath);
-    if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
-        qWarning() << "Could not open file for analysis:" << filePath;
-        return;
+    // The token streams are only needed while analyzing
+    analyzedFiles.clear();
+    detector.clear();
+    similarityDetector.clear();
+}
+
+void CodeAnalyzer::abandonJob()
+{
+    releaseState();
+    if (pendingJobs.fetchAndAddOrdered(-1) == 1)
+        emit analysisCancelled();
+}
+
+RepetitionResults CodeAnalyzer::resultsOf(const QVector<TokenCloneDetector::CloneClass> &classes) const
+{
+    RepetitionResults results;
+    // Detector file index -> index into results.files
+    QVector<int> fileIds(analyzedFiles.size(), -1);
+    int groupId = 0;
+    for (const TokenCloneDetector::CloneClass &clone : classes) {
+        // Long lines of dense code can reach MinCloneTokens in a couple of lines
+        const TokenCloneDetector::CloneOccurrence &first = clone.occurrences.first();
+        if (first.endLine - first.startLine + 1 < MIN_LINES_FOR_REPETITION)
+            continue;
+        for (const TokenCloneDetector::CloneOccurrence &occurrence : clone.occurrences) {
+            int &fileId = fileIds[occurrence.fileIndex];
+            if (fileId < 0) {
+                fileId = results.files.size();
+                results.files.append(analyzedFiles.at(occurrence.fileIndex));
+            }
+            results.repetitions.append(CodeRepetition{clone.hash, fileId, occurrence.startLine,
+                                                      occurrence.endLine, groupId});
+        }
+        ++groupId;
+    }
+    results.repetitions.squeeze();
+    return results;
+}
+
+RepetitionResults CodeAnalyzer::resultsOf(const QVector<NearDuplicateDetector::SimilarPair> &pairs) const
+{
+    RepetitionResults results;
+    QVector<int> fileIds(analyzedFiles.size(), -1);
+    const QVector<NearDuplicateDetector::Function> &functions = similarityDetector.functions();
+    int groupId = 0;
+    for (const NearDuplicateDetector::SimilarPair &pair : pairs) {
+        const NearDuplicateDetector::Function &first = functions.at(pair.first);
+        const NearDuplicateDetector::Function &second = functions.at(pair.second);
+        if (first.endLine - first.startLine + 1 < MIN_LINES_FOR_REPETITION
+            || second.endLine - second.startLine + 1 < MIN_LINES_FOR_REPETITION)
+            continue;
+        for (const NearDuplicateDetector::Function *function : {&first, &second}) {
+            int &fileId = fileIds[function->fileIndex];
+            if (fileId < 0) {
+                fileId = results.files.size();
+                results.files.append(analyzedFiles.at(function->fileIndex));
+            }
+            // The copies differ, so there is no shared token hash
+            results.repetitions.append(CodeRepetition{0, fileId, function->startLine, function->endLine, groupId});
+        }
+        results.similarities.append(pair.similarity);
+        ++groupId;
+    }
+    results.repetitions.squeeze();
+    return results;
+}
+
+QByteArray CodeAnalyzer::fingerprintOf(const QVector<AnalyzedFile> &entries, AnalysisMode mode) const
+{
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    hash.addData(QByteArray::number(int(mode)) + ' ' + QByteArray::number(MinCloneTokens) + ' '
+                 + QByteArray::number(MinSimilarity) + ' ' + QByteArray::number(MIN_LINES_FOR_REPETITION) + '\n');
+    for (const AnalyzedFile &entry : entries) {
+        hash.addData(entry.filePath.toUtf8());
+        hash.addData(QByteArray(1, '\0'));
+        hash.addData(entry.contentHash);
+    }
+    return hash.result();
+}
+
+bool CodeAnalyzer::loadResults(const QString &projectPath, AnalysisMode mode, const QByteArray &fingerprint,
+                               RepetitionResults &results)
+{
+    const QDir root(projectPath);
+    bool matches = false;
+    const bool ok = resultsFile(projectPath, mode).read([&](QDataStream &in) {
+        QByteArray storedFingerprint;
+        in >> storedFingerprint;
+        matches = storedFingerprint == fingerprint;
+        if (!matches)
+            return;
+
+        quint32 fileCount = 0;
+        in >> fileCount;
+        for (quint32 i = 0; i < fileCount && in.status() == QDataStream::Ok; ++i) {
+            QByteArray relativePath;
+            in >> relativePath;
+            results.files.append(root.absoluteFilePath(QString::fromUtf8(relativePath)));
+        }
+        quint32 repetitionCount = 0;
+        in >> repetitionCount;
+        results.repetitions.reserve(repetitionCount);
+        for (quint32 i = 0; i < repetitionCount && in.status() == QDataStream::Ok; ++i) {
+            CodeRepetition repetition;
+            qint32 fileId = 0;
+            qint32 startLine = 0;
+            qint32 endLine = 0;
+            qint32 groupId = 0;
+            in >> repetition.hash >> fileId >> startLine >> endLine >> groupId;
+            repetition.fileId = fileId;
+            repetition.startLine = startLine;
+            repetition.endLine = endLine;
+            repetition.groupId = groupId;
+            results.repetitions.append(repetition);
+        }
+        in >> results.similarities;
+    });
+    if (!ok || !matches) {
+        results = RepetitionResults();
+        return false;
     }
+    return true;
+}
+
+void CodeAnalyzer::saveResults(const QString &projectPath, AnalysisMode mode, const QByteArray &fingerprint,
+                               const RepetitionResults &results)
+{
+    const QDir root(projectPath);
+    resultsFile(projectPath, mode).write([&](QDataStream &out) {
+        out << fingerprint << quint32(results.files.size());
+        for (const QString &filePath : results.files) {
+            out << root.relativeFilePath(filePath).toUtf8();
+        }
+        out << quint32(results.repetitions.size());
+        for (const CodeRepetition &repetition : results.repetitions) {
+            out << repetition.hash << qint32(repetition.fileId) << qint32(repetition.startLine)
+                << qint32(repetition.endLine) << qint32(repetition.groupId);
+        }
+        out << results.similarities;
+    });
+}
+
+AnalysisScanConsumer::AnalysisScanConsumer(const QStringList &folders, bool useCache)
+    : folders(folders), useCache(useCache)
+{
+}
 
-    QTextStream in(&file);
-    QList<QString> processedLines;
-    int currentLineNumber = 0;
+void AnalysisScanConsumer::setRefreshOnly(bool refreshOnly)
+{
+    this->refreshOnly = refreshOnly;
+}
 
-    QRegularExpression useRegex("^\\s*use\\s+[^;]+;");
-    QRegularExpression classRegex("^\\s*(?:abstract\\s+|final\\s+)?class\\s+\\w+");
-    QRegularExpression namespaceRegex("^\\s*namespace\\s+[A-Za-z0-9_\\]+(?:\\s*;|\\s*\\{)?$");
+QVector<int> AnalysisScanConsumer::prepare(const QString &projectPath, const QVector<ScannedFile> &files)
+{
+    this->projectPath = useCache ? projectPath : QString();
+    QHash<QString, AnalyzedFile> cachedFiles;
+    const bool cached = !this->projectPath.isEmpty() && AnalysisCache(projectPath).load(cachedFiles);
 
-    while (!in.atEnd()) {
-        QString line = in.readLine();
-        currentLineNumber++;
+    entries.clear();
+    entryOf.fill(-1, files.size());
+    stale = 0;
+    cacheChanged = false;
+    if (refreshOnly && !cached) {
+        this->projectPath.clear();
+        return QVector<int>();
+    }
 
-        // Ignore lines with use, class, or namespace declarations
-        if (line.contains(useRegex) || line.contains(classRegex) || line.contains(namespaceRegex)) {
+    QStringList prefixes;
+    for (const QString &folder : std::as_const(folders)) {
+        prefixes.append(QDir::cleanPath(QDir(projectPath).filePath(folder)) + '/');
+    }
+
+    auto inFolders = [&prefixes](const QString &filePath) {
+        return prefixes.isEmpty() || std::any_of(prefixes.cbegin(), prefixes.cend(), [&filePath](const QString &prefix) {
+            return filePath.startsWith(prefix);
+        });
+    };
+
+    // Reuse cached token streams whose modification time and size still
+    // match; the rest are re-read. Whatever is left in cachedFiles below the
+    // folders afterwards was deleted or is ignored now.
+    QVector<int> wanted;
+    for (int i = 0; i < files.size(); ++i) {
+        const ScannedFile &file = files.at(i);
+        if (!inFolders(file.filePath))
             continue;
+        AnalyzedFile entry = cachedFiles.take(file.filePath);
+        if (entry.filePath.isEmpty() || entry.modified != file.modified || entry.size != file.size) {
+            entry.filePath = file.filePath;
+            entry.modified = file.modified;
+            entry.size = file.size;
+            wanted.append(i);
         }
-        processedLines.append(line);
+        entryOf[i] = entries.size();
+        entries.append(entry);
+    }
+    stale = wanted.size();
+    cacheChanged = stale > 0 || std::any_of(cachedFiles.keyBegin(), cachedFiles.keyEnd(), inFolders);
+    return wanted;
+}
+
+void AnalysisScanConsumer::consume(int fileIndex, const QByteArray &content)
+{
+    AnalyzedFile &entry = entries[entryOf.at(fileIndex)];
+    // Touched but unchanged: keep the cached tokens
+    const QByteArray contentHash = QCryptographicHash::hash(content, QCryptographicHash::Md5);
+    if (contentHash == entry.contentHash) {
+        return;
     }
-    file.close();
+    entry.contentHash = contentHash;
+    entry.tokens = TokenCloneDetector::tokenize(content);
+}
+
+void AnalysisScanConsumer::readFailed(int fileIndex)
+{
+    AnalyzedFile &entry = entries[entryOf.at(fileIndex)];
+    entry.contentHash.clear();
+    entry.tokens = TokenCloneDetector::FileTokens();
+}
 
-    // Iterate through processed lines to find snippets
-    for (int i = 0; i < processedLines.size() - MIN_LINES_FOR_REPETITION + 1; ++i) {
-        QString currentSnippet;
-        for (int j = 0; j < MIN_LINES_FOR_REPETITION; ++j) {
-            currentSnippet += processedLines.at(i + j) + "\n";
+void AnalysisScanConsumer::finish(bool completed)
+{
+    entryOf = QVector<int>();
+    if (!completed) {
+        entries = QVector<AnalyzedFile>();
+        return;
+    }
+    if (!projectPath.isEmpty() && cacheChanged) {
+        QHash<QString, AnalyzedFile> analyzed;
+        analyzed.reserve(entries.size());
+        for (const AnalyzedFile &entry : std::as_const(entries)) {
+            analyzed.insert(entry.filePath, entry);
         }
+        AnalysisCache(projectPath).update(analyzed, folders);
+    }
+}
 
-        // Calculate hash of the snippet
-        QByteArray hash = QCryptographicHash::hash(currentSnippet.toUtf8(), QCryptographicHash::Md5);
-        QString snippetHash = QString(hash.toHex());
+QVector<AnalyzedFile> AnalysisScanConsumer::takeEntries()
+{
+    return std::exchange(entries, QVector<AnalyzedFile>());
+}
 
-        // Store the snippet and its location
-        CodeRepetition repetition;
-        repetition.filePath = filePath;
-        // Note: startLine and endLine here will be relative to processedLines, not original file lines.
-        // For accurate line numbers, we'd need to map back to original line numbers.
-        // For now, this is a simplification.
-        repetition.startLine = i + 1; // Line numbers are 1-based
-        repetition.endLine = i + MIN_LINES_FOR_REPETITION;
-        repetition.snippet = currentSnippet.trimmed(); // Store trimmed snippet
+QString CodeAnalyzer::snippet(const QString &filePath, int startLine, int endLine)
+{
+    QFile file(filePath);
+    if (!file.open(QIODevice::ReadOnly))
+        return QString();
+    const QByteArray content = file.readAll();
+    return snippetText(content, lineStartsOf(content), startLine, endLine);
+}
 
-        snippetHashes[snippetHash].append(repetition);
+qsizetype RepetitionResults::memoryUsage() const
+{
+    qsizetype bytes = repetitions.capacity() * qsizetype(sizeof(CodeRepetition))
+        + similarities.capacity() * qsizetype(sizeof(float));
+    for (const QString &path : files) {
+        bytes += qsizetype(sizeof(QString)) + path.capacity() * qsizetype(sizeof(QChar));
+    }
+    return bytes;
+}
+
+qsizetype RepetitionResults::eagerMemoryUsage() const
+{
+    // The old record: path, start and end line, snippet, group
+    struct EagerRepetition {
+        QString filePath;
+        int startLine;
+        int endLine;
+        QString snippet;
+        int groupId;
+    };
+
+    QVector<QVector<int>> byFile(files.size());
+    for (int i = 0; i < repetitions.size(); ++i) {
+        byFile[repetitions.at(i).fileId].append(i);
+    }
+    qsizetype bytes = repetitions.size() * qsizetype(sizeof(EagerRepetition));
+    for (const QString &path : files) {
+        bytes += qsizetype(sizeof(QString)) + path.size() * qsizetype(sizeof(QChar));
+    }
+    for (int fileId = 0; fileId < files.size(); ++fileId) {
+        QFile file(files.at(fileId));
+        const QByteArray content = file.open(QIODevice::ReadOnly) ? file.readAll() : QByteArray();
+        const QVector<qsizetype> lineStarts = lineStartsOf(content);
+        for (int index : std::as_const(byFile.at(fileId))) {
+            const CodeRepetition &repetition = repetitions.at(index);
+            // Paths were implicitly shared; every snippet was its own string
+            bytes += snippetText(content, lineStarts, repetition.startLine, repetition.endLine).size() * qsizetype(sizeof(QChar));
+        }
     }
+    return bytes;
 }
@@ -3,16 +3,83 @@
 
 #include <QObject>
 #include <QString>
-#include <QMap>
+#include <QStringList>
+#include <QHash>
 #include <QList>
-#include <QRegularExpression>
+#include <QVector>
+#include <QByteArray>
+#include <QAtomicInt>
+#include "TokenCloneDetector.h"
+#include "NearDuplicateDetector.h"
+#include "AnalysisCache.h"
+#include "ProjectScanner.h"
 
-// Structure to hold information about a code repetition
+class QThreadPool;
+
+// Location of one copy of a clone. The text isn't kept; it is read with
+// CodeAnalyzer::snippet() when a result is displayed.
 struct CodeRepetition {
-    QString filePath;
-    int startLine;
-    int endLine;
-    QString snippet; // The actual repeated code snippet
+    quint64 hash = 0; // of the normalized tokens, equal for all copies; 0 for similar functions
+    int fileId = -1;  // index into RepetitionResults::files
+    int startLine = 0;
+    int endLine = 0;
+    int groupId = -1; // Repetitions with the same groupId are copies of each other
+};
+
+// Everything one analysis found. The containers are implicitly shared, so
+// passing results through queued signals doesn't copy them.
+struct RepetitionResults {
+    QStringList files; // only files with at least one repetition
+    QVector<CodeRepetition> repetitions; // grouped by clone class
+    // Estimated similarity of each group's pair of functions, 0-1; empty
+    // for exact clones
+    QVector<float> similarities;
+
+    QString filePath(const CodeRepetition &repetition) const { return files.at(repetition.fileId); }
+    int groupCount() const { return repetitions.isEmpty() ? 0 : repetitions.last().groupId + 1; }
+
+    qsizetype memoryUsage() const;
+    // What the same results took when every repetition carried its own path
+    // and snippet copy. Reads all snippets, so only meant for reports.
+    qsizetype eagerMemoryUsage() const;
+};
+
+// Brings the analysis cache up to date during a scan: cached token streams
+// are reused, changed files are tokenized from the bytes the scanner read.
+// CodeAnalyzer runs one for its own pass; registered with the indexer, it
+// tokenizes the analyzed folders while the project is being indexed, so a
+// later analysis doesn't read them again.
+class AnalysisScanConsumer : public ScanConsumer
+{
+public:
+    // Only files below these project folders are kept; all files if empty.
+    // Without the cache every kept file is read.
+    explicit AnalysisScanConsumer(const QStringList &folders = QStringList(), bool useCache = true);
+
+    // Only keep an existing cache current: a project that was never
+    // analyzed isn't tokenized. For consumers registered with the indexer.
+    void setRefreshOnly(bool refreshOnly);
+
+    QVector<int> prepare(const QString &projectPath, const QVector<ScannedFile> &files) override;
+    void consume(int fileIndex, const QByteArray &content) override;
+    void readFailed(int fileIndex) override;
+    // Updates the cache for the folders when a scan completed
+    void finish(bool completed) override;
+
+    // Files of the last completed scan, in walk order
+    QVector<AnalyzedFile> takeEntries();
+    // Files that had to be read in the last scan
+    int staleCount() const { return stale; }
+
+private:
+    QStringList folders;
+    bool useCache;
+    bool refreshOnly = false;
+    QString projectPath;
+    QVector<AnalyzedFile> entries;
+    QVector<int> entryOf; // scanned file -> entry, -1 if not analyzed
+    int stale = 0;
+    bool cacheChanged = false;
 };
 
 class CodeAnalyzer : public QObject
@@ -21,26 +88,91 @@ class CodeAnalyzer : public QObject
 public:
     explicit CodeAnalyzer(QObject *parent = nullptr);
 
-    // Method to start the analysis for a list of directories
-    void analyzePaths(const QList<QString> &paths);
+    enum AnalysisMode {
+        // Token sequences repeated exactly, up to renamed identifiers and literals
+        CloneAnalysis,
+        // Pairs of functions that are mostly alike, with statements added,
+        // removed or changed
+        SimilarityAnalysis
+    };
+    Q_ENUM(AnalysisMode)
+
+    // Method to start the analysis for a list of directories. Runs on the
+    // analyzer's thread and replaces any analysis still running. The paths
+    // are walked with projectPath's ignore rules, and token streams are
+    // cached in its .incode directory so only changed files are re-read on
+    // the next run; if none changed, the last results are reused.
+    void analyzePaths(const QList<QString> &paths, const QString &projectPath = QString(),
+                      AnalysisMode mode = CloneAnalysis);
+    // Stops the running analysis at the next file. Safe from any thread.
+    void cancelAnalysis();
+
+    // Number of files fingerprinted in parallel (defaults to one per core)
+    void setThreadCount(int count);
+    int threadCount() const;
+
+    // Whether .incode/analysis.cache is read and written (default on). Set
+    // it before analysis starts.
+    void setCacheEnabled(bool enabled);
+    bool cacheEnabled() const;
+
+    // Lines startLine..endLine of the file as it is on disk
+    static QString snippet(const QString &filePath, int startLine, int endLine);
+
+    // Minimum time between two analysisProgress emissions
+    static constexpr int ProgressIntervalMsecs = 100;
+    // Minimum time between two partialResults emissions
+    static constexpr int PartialResultsIntervalMsecs = 1000;
+    // Shortest clone reported, in normalized tokens
+    static constexpr int MinCloneTokens = 50;
+    // Least estimated similarity of a reported pair of functions
+    static constexpr float MinSimilarity = 0.8f;
+
+public slots:
+    void doAnalyzePaths(const QList<QString> &paths, const QString &projectPath, AnalysisMode mode, int job);
 
 signals:
+    void startAnalysis(const QList<QString> &paths, const QString &projectPath, AnalysisMode mode, int job);
+    void analysisProgress(int progress);
+    // The clone classes found so far while clone detection walks its
+    // intervals, all of them each time. analysisFinished() replaces them
+    // with the final list, which drops some and orders them differently.
+    void partialResults(const RepetitionResults &results);
     // Signal emitted when analysis is complete, providing the repetitions found
-    void analysisFinished(const QList<CodeRepetition> &repetitions);
+    void analysisFinished(const RepetitionResults &results);
+    // The last requested analysis was cancelled; not emitted when a newer one replaced it
+    void analysisCancelled();
 
 private:
-    // Helper to analyze a single file
-    void analyzeFile(const QString &filePath);
+    // One CodeRepetition per clone occurrence, grouped by clone class
+    RepetitionResults resultsOf(const QVector<TokenCloneDetector::CloneClass> &classes) const;
+    // One group of two per similar pair of functions
+    RepetitionResults resultsOf(const QVector<NearDuplicateDetector::SimilarPair> &pairs) const;
+
+    // Identifies a run's input: the settings and every file's content
+    QByteArray fingerprintOf(const QVector<AnalyzedFile> &entries, AnalysisMode mode) const;
+    // The last results of mode in .incode, if they were found for the same input
+    static bool loadResults(const QString &projectPath, AnalysisMode mode, const QByteArray &fingerprint,
+                            RepetitionResults &results);
+    static void saveResults(const QString &projectPath, AnalysisMode mode, const QByteArray &fingerprint,
+                            const RepetitionResults &results);
+
+    bool isCancelled(int job) const { return currentJob.loadAcquire() != job; }
+    void releaseState();
+    void abandonJob();
 
-    // Store detected repetitions
-    QList<CodeRepetition> detectedRepetitions;
+    // Files in the order they were added to the detector
+    QStringList analyzedFiles;
+    TokenCloneDetector detector;
+    NearDuplicateDetector similarityDetector;
 
-    // Map to store hashes of code snippets and their locations
-    // Key: hash of the snippet
-    // Value: List of locations where this snippet appears
-    QMap<QString, QList<CodeRepetition>> snippetHashes;
+    QThreadPool *workerPool;
+    bool useCache = true;
+    // Bumped for every requested analysis and on cancel
+    QAtomicInt currentJob;
+    QAtomicInt pendingJobs;
 
-    // Minimum number of lines for a snippet to be considered for repetition
+    // Minimum number of lines a clone must span to be reported
     const int MIN_LINES_FOR_REPETITION = 5;
 };
 
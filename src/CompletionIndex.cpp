@@ -0,0 +1,200 @@
+#include "CompletionIndex.h"
+#include <algorithm>
+
+namespace {
+
+struct Candidate {
+    int score;
+    int id;
+};
+
+// Higher scores first, then alphabetical
+bool ranksBefore(const Candidate &a, const Candidate &b)
+{
+    return a.score != b.score ? a.score > b.score : a.id < b.id;
+}
+
+} // namespace
+
+CompletionIndex::CompletionIndex(const QStringList &names)
+{
+    QVector<int> order(names.size());
+    QStringList foldedNames;
+    foldedNames.reserve(names.size());
+    for (int i = 0; i < names.size(); ++i) {
+        order[i] = i;
+        foldedNames.append(fold(names.at(i)));
+    }
+    std::sort(order.begin(), order.end(), [&](int a, int b) {
+        const int byFolded = foldedNames.at(a).compare(foldedNames.at(b));
+        return byFolded != 0 ? byFolded < 0 : names.at(a) < names.at(b);
+    });
+
+    qsizetype totalLength = 0;
+    for (const QString &name : names) {
+        totalLength += name.size();
+    }
+    nameArena.reserve(totalLength);
+    foldedArena.reserve(totalLength);
+    offsets.reserve(names.size() + 1);
+    masks.reserve(names.size());
+
+    for (int index : std::as_const(order)) {
+        offsets.append(quint32(nameArena.size()));
+        nameArena.append(names.at(index));
+        foldedArena.append(foldedNames.at(index));
+        masks.append(characterMask(foldedNames.at(index)));
+    }
+    offsets.append(quint32(nameArena.size()));
+}
+
+QStringList CompletionIndex::complete(const QString &prefix, int limit) const
+{
+    QStringList result;
+    const int count = size();
+    if (prefix.isEmpty() || limit <= 0 || count == 0)
+        return result;
+
+    const QString folded = fold(prefix);
+    // The best `limit` candidates so far; the heap's top is the worst of them
+    QVector<Candidate> best;
+    best.reserve(qMin(limit, count) + 1);
+    auto offer = [&best, limit](int score, int id) {
+        const Candidate candidate{score, id};
+        if (best.size() < limit) {
+            best.append(candidate);
+            std::push_heap(best.begin(), best.end(), ranksBefore);
+        } else if (ranksBefore(candidate, best.first())) {
+            std::pop_heap(best.begin(), best.end(), ranksBefore);
+            best.last() = candidate;
+            std::push_heap(best.begin(), best.end(), ranksBefore);
+        }
+    };
+
+    // Prefix matches, preferring the exact case and then shorter names
+    const int first = lowerBound(folded);
+    const int last = prefixEnd(first, folded);
+    for (int id = first; id < last; ++id) {
+        const QStringView name = nameAt(id);
+        int score = 100000 - int(name.size());
+        if (name.startsWith(prefix))
+            score += 1000;
+        offer(score, id);
+    }
+
+    // Fuzzy subsequence matches for everything else, if there is room
+    if (last - first < limit && folded.size() >= 2) {
+        const quint64 queryMask = characterMask(folded);
+        for (int id = 0; id < count; ++id) {
+            if (id == first && last > first) {
+                id = last - 1;
+                continue;
+            }
+            if (queryMask & ~masks.at(id))
+                continue;
+            const int score = fuzzyScore(id, folded);
+            if (score > 0)
+                offer(score, id);
+        }
+    }
+
+    std::sort_heap(best.begin(), best.end(), ranksBefore);
+    result.reserve(best.size());
+    for (const Candidate &candidate : std::as_const(best)) {
+        result.append(nameAt(candidate.id).toString());
+    }
+    return result;
+}
+
+QStringView CompletionIndex::foldedAt(int id) const
+{
+    return QStringView(foldedArena).mid(offsets.at(id), offsets.at(id + 1) - offsets.at(id));
+}
+
+QStringView CompletionIndex::nameAt(int id) const
+{
+    return QStringView(nameArena).mid(offsets.at(id), offsets.at(id + 1) - offsets.at(id));
+}
+
+int CompletionIndex::lowerBound(const QString &folded) const
+{
+    int low = 0;
+    int high = size();
+    while (low < high) {
+        const int middle = low + (high - low) / 2;
+        if (foldedAt(middle).compare(folded) < 0)
+            low = middle + 1;
+        else
+            high = middle;
+    }
+    return low;
+}
+
+int CompletionIndex::prefixEnd(int first, const QString &folded) const
+{
+    // First name at or after `first` that doesn't start with the prefix
+    int low = first;
+    int high = size();
+    while (low < high) {
+        const int middle = low + (high - low) / 2;
+        if (foldedAt(middle).startsWith(folded))
+            low = middle + 1;
+        else
+            high = middle;
+    }
+    return low;
+}
+
+int CompletionIndex::fuzzyScore(int id, const QString &folded) const
+{
+    const QStringView name = nameAt(id);
+    const QStringView foldedName = foldedAt(id);
+    int score = 0;
+    int matched = 0;
+    int lastMatch = -2;
+
+    for (int i = 0; i < foldedName.size() && matched < folded.size(); ++i) {
+        if (foldedName.at(i) != folded.at(matched))
+            continue;
+        int bonus = 10;
+        if (i == lastMatch + 1)
+            bonus += 15; // consecutive characters
+        if (i == 0 || name.at(i - 1) == QLatin1Char('_')
+            || (name.at(i).isUpper() && name.at(i - 1).isLower()))
+            bonus += 20; // start of a word: snake_case or camelCase
+        score += bonus;
+        lastMatch = i;
+        ++matched;
+    }
+
+    if (matched < folded.size())
+        return 0;
+    return qMax(1, score - int(foldedName.size() - folded.size()));
+}
+
+QString CompletionIndex::fold(const QString &text)
+{
+    // Fold per character so that folded and original names have equal length
+    QString folded(text);
+    for (QChar &c : folded) {
+        c = c.toCaseFolded();
+    }
+    return folded;
+}
+
+quint64 CompletionIndex::characterMask(QStringView folded)
+{
+    quint64 mask = 0;
+    for (QChar c : folded) {
+        const ushort u = c.unicode();
+        int bit = 37;
+        if (u >= 'a' && u <= 'z')
+            bit = u - 'a';
+        else if (u >= '0' && u <= '9')
+            bit = 26 + (u - '0');
+        else if (u == '_')
+            bit = 36;
+        mask |= quint64(1) << bit;
+    }
+    return mask;
+}
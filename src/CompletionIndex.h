@@ -0,0 +1,43 @@
+#ifndef INCODE_COMPLETIONINDEX_H
+#define INCODE_COMPLETIONINDEX_H
+
+#include <QString>
+#include <QStringList>
+#include <QVector>
+
+// Ranked symbol completion shared by all editors. Names are kept once, sorted
+// by their case-folded form, so prefix matches are a binary-searched range;
+// when those don't fill the result, the remaining names are scored as fuzzy
+// subsequence matches ("gUsrNm" -> "getUserName"). A per-name character mask
+// rejects most non-matches before the subsequence check. Every name is
+// scored and the best ones are kept in a heap of the result size, so a good
+// match late in the alphabet isn't cut off. incode-core-bench --completion
+// times queries against a generated index.
+class CompletionIndex
+{
+public:
+    CompletionIndex() = default;
+    explicit CompletionIndex(const QStringList &names);
+
+    // Best matches for what the user typed, best first
+    QStringList complete(const QString &prefix, int limit) const;
+
+    int size() const { return offsets.isEmpty() ? 0 : offsets.size() - 1; }
+
+private:
+    QStringView foldedAt(int id) const;
+    QStringView nameAt(int id) const;
+    int lowerBound(const QString &folded) const;
+    int prefixEnd(int first, const QString &folded) const;
+    int fuzzyScore(int id, const QString &folded) const;
+    static QString fold(const QString &text);
+    static quint64 characterMask(QStringView folded);
+
+    // Original and case-folded names share offsets: folding is per character
+    QString nameArena;
+    QString foldedArena;
+    QVector<quint32> offsets;
+    QVector<quint64> masks;
+};
+
+#endif // INCODE_COMPLETIONINDEX_H
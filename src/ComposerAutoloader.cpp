@@ -0,0 +1,216 @@
+#include "ComposerAutoloader.h"
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QRegularExpression>
+#include <QDebug>
+#include <cstring>
+
+namespace {
+
+// Reads the PHP single-quoted string whose opening quote is at pos and moves
+// pos past the closing one. Only \\ and \' are escapes in such strings.
+bool readQuoted(const QByteArray &line, int &pos, QByteArray &value)
+{
+    value.clear();
+    for (++pos; pos < line.size(); ++pos) {
+        char c = line.at(pos);
+        if (c == '\'') {
+            ++pos;
+            return true;
+        }
+        if (c == '\\' && pos + 1 < line.size() && (line.at(pos + 1) == '\\' || line.at(pos + 1) == '\''))
+            c = line.at(++pos);
+        value.append(c);
+    }
+    return false;
+}
+
+// One "'key' => value," line of a file Composer generated: the key, and the
+// paths in the value, which Composer writes as $vendorDir . '/...' or
+// $baseDir . '/...' (inside array(...) for PSR-4)
+bool parseEntry(const QByteArray &line, const QString &vendorDir, const QString &baseDir,
+                QString &key, QStringList &paths)
+{
+    int pos = line.indexOf('\'');
+    QByteArray text;
+    if (pos < 0 || !readQuoted(line, pos, text))
+        return false;
+    const int arrow = line.indexOf("=>", pos);
+    if (arrow < 0)
+        return false;
+    key = QString::fromUtf8(text);
+
+    paths.clear();
+    pos = arrow + 2;
+    for (int variable = line.indexOf('$', pos); variable >= 0; variable = line.indexOf('$', pos)) {
+        const char *start = line.constData() + variable;
+        const QString *base = std::strncmp(start, "$vendorDir", 10) == 0 ? &vendorDir
+                            : std::strncmp(start, "$baseDir", 8) == 0   ? &baseDir
+                                                                        : nullptr;
+        pos = line.indexOf('\'', variable);
+        if (pos < 0 || !readQuoted(line, pos, text))
+            break;
+        if (base)
+            paths.append(QDir::cleanPath(*base + QString::fromUtf8(text)));
+    }
+    return !paths.isEmpty();
+}
+
+QJsonObject readComposerJson(const QString &projectPath)
+{
+    QFile file(QDir(projectPath).filePath("composer.json"));
+    if (!file.open(QIODevice::ReadOnly))
+        return QJsonObject();
+    QJsonParseError error;
+    const QJsonDocument document = QJsonDocument::fromJson(file.readAll(), &error);
+    if (error.error != QJsonParseError::NoError) {
+        qWarning() << "Could not parse" << file.fileName() << ":" << error.errorString();
+        return QJsonObject();
+    }
+    return document.object();
+}
+
+} // namespace
+
+ComposerAutoloader ComposerAutoloader::forProject(const QString &projectPath)
+{
+    ComposerAutoloader autoloader;
+    const QString baseDir = QDir::cleanPath(projectPath);
+    const QJsonObject composerJson = readComposerJson(baseDir);
+    const QString vendorDirName = composerJson["config"].toObject()["vendor-dir"].toString("vendor");
+    const QString vendorDir = QDir::cleanPath(QDir(baseDir).filePath(vendorDirName));
+
+    // The generated files cover the project's own autoload section too
+    autoloader.loadGenerated(vendorDir + "/composer/autoload_classmap.php", vendorDir, baseDir, false);
+    autoloader.loadGenerated(vendorDir + "/composer/autoload_psr4.php", vendorDir, baseDir, true);
+    if (autoloader.psr4.isEmpty()) {
+        autoloader.addComposerJsonPrefixes(composerJson["autoload"].toObject(), baseDir);
+        autoloader.addComposerJsonPrefixes(composerJson["autoload-dev"].toObject(), baseDir);
+    }
+
+    if (!autoloader.isEmpty()) {
+        qDebug() << "Composer autoload:" << autoloader.classMapSize() << "mapped classes,"
+                 << autoloader.prefixCount() << "PSR-4 prefixes";
+    }
+    return autoloader;
+}
+
+void ComposerAutoloader::loadGenerated(const QString &filePath, const QString &vendorDir, const QString &baseDir,
+                                       bool isPsr4)
+{
+    QFile file(filePath);
+    if (!file.open(QIODevice::ReadOnly))
+        return;
+
+    // Composer writes one entry per line, after the "return array(" line
+    const QList<QByteArray> lines = file.readAll().split('\n');
+    QString key;
+    QStringList paths;
+    for (const QByteArray &line : lines) {
+        if (!parseEntry(line, vendorDir, baseDir, key, paths))
+            continue;
+        if (isPsr4)
+            psr4[key] += paths;
+        else
+            classMap.insert(key, paths.first());
+    }
+}
+
+void ComposerAutoloader::addComposerJsonPrefixes(const QJsonObject &autoload, const QString &baseDir)
+{
+    const QJsonObject prefixes = autoload["psr-4"].toObject();
+    for (auto it = prefixes.constBegin(); it != prefixes.constEnd(); ++it) {
+        // A prefix maps to one directory or a list of them
+        const QJsonArray directories = it.value().isArray() ? it.value().toArray() : QJsonArray{it.value()};
+        QStringList &paths = psr4[it.key()];
+        for (const QJsonValue &directory : directories) {
+            paths.append(QDir::cleanPath(QDir(baseDir).filePath(directory.toString())));
+        }
+    }
+}
+
+QString ComposerAutoloader::resolve(const QString &qualifiedName) const
+{
+    const QString name = qualifiedName.startsWith('\\') ? qualifiedName.mid(1) : qualifiedName;
+    if (name.isEmpty())
+        return QString();
+
+    const auto mapped = classMap.constFind(name);
+    if (mapped != classMap.constEnd())
+        return mapped.value();
+
+    // Longest namespace prefix first, as Composer's ClassLoader does; the
+    // rest of the name becomes a path below the prefix's directories
+    auto findIn = [&name](const QStringList &directories, int prefixLength) {
+        const QString relative = QString(name.mid(prefixLength)).replace('\\', '/') + ".php";
+        for (const QString &directory : directories) {
+            const QString candidate = directory + '/' + relative;
+            if (QFileInfo::exists(candidate))
+                return candidate;
+        }
+        return QString();
+    };
+    for (int separator = name.lastIndexOf('\\'); separator > 0; separator = name.lastIndexOf('\\', separator - 1)) {
+        const auto directories = psr4.constFind(name.left(separator + 1));
+        if (directories == psr4.constEnd())
+            continue;
+        const QString filePath = findIn(directories.value(), separator + 1);
+        if (!filePath.isEmpty())
+            return filePath;
+    }
+    const auto fallback = psr4.constFind(QString());
+    return fallback != psr4.constEnd() ? findIn(fallback.value(), 0) : QString();
+}
+
+QString ComposerAutoloader::qualify(const QString &name, const QString &source)
+{
+    if (name.startsWith('\\'))
+        return name.mid(1);
+
+    // Imports come before the first declaration; 'use' inside a class body
+    // imports a trait, not a name
+    static const QRegularExpression declaration(
+        QStringLiteral("^\\s*(?:(?:abstract|final|readonly)\\s+)*(?:class|interface|trait|enum)\\s+\\w"),
+        QRegularExpression::MultilineOption);
+    static const QRegularExpression namespaceStatement(
+        QStringLiteral("^\\s*namespace\\s+([\\w\\\\]+)\\s*[;{]"), QRegularExpression::MultilineOption);
+    static const QRegularExpression useStatement(
+        QStringLiteral("^\\s*use\\s+\\\\?([\\w\\\\]+?)(?:\\\\\\{([^}]*)\\}|\\s+as\\s+(\\w+))?\\s*;"),
+        QRegularExpression::MultilineOption);
+
+    const QRegularExpressionMatch firstDeclaration = declaration.match(source);
+    const QString header = firstDeclaration.hasMatch() ? source.left(firstDeclaration.capturedStart()) : source;
+
+    const QString firstSegment = name.section('\\', 0, 0);
+    const QString remainder = name.mid(firstSegment.size()); // "" or "\Rest"
+    // PHP class names are case-insensitive
+    auto matches = [&firstSegment](const QString &alias) {
+        return alias.compare(firstSegment, Qt::CaseInsensitive) == 0;
+    };
+
+    QRegularExpressionMatchIterator uses = useStatement.globalMatch(header);
+    while (uses.hasNext()) {
+        const QRegularExpressionMatch use = uses.next();
+        const QString imported = use.captured(1);
+        if (use.capturedLength(2) > 0) {
+            // use Vendor\Package\{First, Second as Alias};
+            const QStringList members = use.captured(2).split(',', Qt::SkipEmptyParts);
+            for (const QString &member : members) {
+                const QStringList parts = member.simplified().split(' ');
+                const QString target = parts.first();
+                const QString alias = parts.size() == 3 ? parts.last() : target.section('\\', -1);
+                if (matches(alias))
+                    return imported + '\\' + target + remainder;
+            }
+        } else if (matches(use.capturedLength(3) > 0 ? use.captured(3) : imported.section('\\', -1))) {
+            return imported + remainder;
+        }
+    }
+
+    const QRegularExpressionMatch currentNamespace = namespaceStatement.match(header);
+    return currentNamespace.hasMatch() ? currentNamespace.captured(1) + '\\' + name : name;
+}
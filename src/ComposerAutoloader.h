@@ -0,0 +1,55 @@
+#ifndef INCODE_COMPOSERAUTOLOADER_H
+#define INCODE_COMPOSERAUTOLOADER_H
+
+#include <QString>
+#include <QStringList>
+#include <QHash>
+
+class QJsonObject;
+
+// Maps fully qualified class names to files the way Composer's autoloader
+// does, from vendor/composer/autoload_classmap.php and autoload_psr4.php
+// (falling back to the "autoload" sections of composer.json before
+// `composer install` ran). This lets navigation reach classes in vendor/,
+// which the indexer doesn't walk: a class is resolved to its file on demand
+// and only that file is indexed.
+//
+// Copies share their tables, so a loaded autoloader can be handed to other
+// threads by value.
+class ComposerAutoloader
+{
+public:
+    // Resolves nothing
+    ComposerAutoloader() = default;
+
+    static ComposerAutoloader forProject(const QString &projectPath);
+
+    bool isEmpty() const { return classMap.isEmpty() && psr4.isEmpty(); }
+    int classMapSize() const { return classMap.size(); }
+    int prefixCount() const { return psr4.size(); }
+
+    // The file that defines a class, interface, trait or enum, or an empty
+    // string. The class map wins; then the longest matching PSR-4 namespace
+    // prefix whose directory has the file.
+    QString resolve(const QString &qualifiedName) const;
+
+    // The fully qualified name a class reference in source means: a leading
+    // backslash is stripped, the first segment is looked up in the file's
+    // use statements (aliases included), and anything else is relative to
+    // the file's namespace
+    static QString qualify(const QString &name, const QString &source);
+
+private:
+    // vendor/composer/autoload_classmap.php or autoload_psr4.php
+    void loadGenerated(const QString &filePath, const QString &vendorDir, const QString &baseDir, bool isPsr4);
+    // The "psr-4" map of an "autoload" section of composer.json
+    void addComposerJsonPrefixes(const QJsonObject &autoload, const QString &baseDir);
+
+    // Fully qualified name (no leading backslash) -> file
+    QHash<QString, QString> classMap;
+    // Namespace prefix ending in a backslash, or "" for fallback
+    // directories -> directories to search
+    QHash<QString, QStringList> psr4;
+};
+
+#endif // INCODE_COMPOSERAUTOLOADER_H
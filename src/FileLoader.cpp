@@ -0,0 +1,71 @@
+#include "FileLoader.h"
+#include <QFile>
+#include <QStringDecoder>
+#include <QThreadPool>
+
+FileLoader::FileLoader(QObject *parent) : QObject(parent), workerPool(new QThreadPool(this))
+{
+    workerPool->setMaxThreadCount(MaxConcurrentLoads);
+}
+
+FileLoader::~FileLoader()
+{
+    {
+        QMutexLocker locker(&jobMutex);
+        shuttingDown = true;
+    }
+    workerPool->waitForDone();
+}
+
+int FileLoader::load(const QString &filePath)
+{
+    const int job = lastJob.fetchAndAddOrdered(1) + 1;
+    {
+        QMutexLocker locker(&jobMutex);
+        runningJobs.insert(job);
+    }
+    workerPool->start([this, job, filePath]() { read(job, filePath); });
+    return job;
+}
+
+void FileLoader::cancel(int job)
+{
+    QMutexLocker locker(&jobMutex);
+    runningJobs.remove(job);
+}
+
+bool FileLoader::isCancelled(int job)
+{
+    QMutexLocker locker(&jobMutex);
+    return shuttingDown || !runningJobs.contains(job);
+}
+
+void FileLoader::read(int job, const QString &filePath)
+{
+    // Text mode drops the '\r' of CRLF line breaks, as reading for the
+    // editor always did
+    QFile file(filePath);
+    if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
+        if (!isCancelled(job))
+            emit loadFailed(job, file.errorString());
+    } else {
+        // Stateful, so a character split between two chunks decodes whole
+        QStringDecoder decoder(QStringDecoder::Utf8);
+        QByteArray buffer(ChunkSize, Qt::Uninitialized);
+        qint64 bytesRead = 0;
+        while (!isCancelled(job) && (bytesRead = file.read(buffer.data(), ChunkSize)) > 0) {
+            const QString text = decoder.decode(QByteArrayView(buffer.constData(), bytesRead));
+            if (!text.isEmpty())
+                emit chunkLoaded(job, text);
+        }
+        if (!isCancelled(job)) {
+            if (bytesRead < 0)
+                emit loadFailed(job, file.errorString());
+            else
+                emit loadFinished(job);
+        }
+    }
+
+    QMutexLocker locker(&jobMutex);
+    runningJobs.remove(job);
+}
@@ -0,0 +1,52 @@
+#ifndef INCODE_FILELOADER_H
+#define INCODE_FILELOADER_H
+
+#include <QObject>
+#include <QString>
+#include <QSet>
+#include <QMutex>
+#include <QAtomicInt>
+
+class QThreadPool;
+
+// Reads and decodes files for the editor off the GUI thread. Each load is a
+// job on a small pool of its own, so several files opened at once are read
+// concurrently and a slow network mount doesn't hold up the event loop.
+// Text arrives in chunks, UTF-8 decoded with line breaks normalized to
+// '\n', through queued signals that carry the job id.
+class FileLoader : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit FileLoader(QObject *parent = nullptr);
+    ~FileLoader();
+
+    // Starts reading a file, returns the job id the signals report
+    int load(const QString &filePath);
+    // No further signals are emitted for the job
+    void cancel(int job);
+
+signals:
+    void chunkLoaded(int job, const QString &text);
+    void loadFinished(int job);
+    void loadFailed(int job, const QString &errorString);
+
+private:
+    // Reads per chunk; large enough that a 10 MB file is a few dozen
+    // document inserts, small enough that each stays well under a frame
+    static const int ChunkSize = 256 * 1024;
+    // Reading is I/O bound; more threads than this only add seeks
+    static const int MaxConcurrentLoads = 4;
+
+    void read(int job, const QString &filePath);
+    bool isCancelled(int job);
+
+    QThreadPool *workerPool;
+    QAtomicInt lastJob;
+    QMutex jobMutex;
+    QSet<int> runningJobs; // not finished and not cancelled
+    bool shuttingDown = false;
+};
+
+#endif // INCODE_FILELOADER_H
@@ -4,10 +4,23 @@
 #include <QString>
 #include <QMap>
 #include <QStringList>
+#include <QList>
+
+// What kind of declaration a symbol comes from
+enum class SymbolKind : quint8 {
+    Class,
+    Interface,
+    Trait,
+    Enum,
+    Function,
+    Method,
+    Constant
+};
 
 struct SymbolLocation {
     QString filePath;
     int lineNumber;
+    SymbolKind kind = SymbolKind::Class;
 };
 
 class ISymbolProvider {
@@ -17,11 +30,28 @@ public:
     // Method to find the definition of a symbol
     virtual SymbolLocation findSymbolLocation(const QString &symbolName) const = 0;
 
+    // Every definition of a symbol (a name can be defined in many files),
+    // best candidate first
+    virtual QList<SymbolLocation> findSymbolLocations(const QString &symbolName) const = 0;
+
+    // Definition of a fully qualified class, interface, trait or enum name
+    // found through the project's Composer autoload rules, which also reach
+    // classes that weren't indexed (vendor/). lineNumber is -1 if there is
+    // no such file.
+    virtual SymbolLocation resolveClass(const QString &qualifiedName) = 0;
+
+    // Every place a symbol name is used (definitions included)
+    virtual QList<SymbolLocation> findReferences(const QString &symbolName) const = 0;
+
     // Method to index a directory (e.g., when a folder is opened)
     virtual void indexDirectory(const QString &directoryPath) = 0;
 
-    // Retrieve all indexed symbol names for completion
+    // Retrieve all indexed symbol names
     virtual QStringList allSymbols() const = 0;
+
+    // Ranked completion candidates (prefix, then fuzzy matches) for the text
+    // being typed. Shared by every editor; no per-editor copy of the names.
+    virtual QStringList completeSymbol(const QString &prefix, int limit) const = 0;
 };
 
 #endif // ISYMBOLPROVIDER_H
@@ -0,0 +1,214 @@
+#include "IgnoreRules.h"
+#include <QDir>
+#include <QFile>
+#include <QDebug>
+
+const char *IgnoreRules::defaultRules()
+{
+    return ".git/\n"
+           ".svn/\n"
+           ".hg/\n"
+           ".incode/\n"
+           "vendor/\n"
+           "node_modules/\n"
+           "/storage/framework/\n"
+           "/bootstrap/cache/\n";
+}
+
+IgnoreRules IgnoreRules::forProject(const QString &projectPath)
+{
+    IgnoreRules rules;
+    rules.root = QDir::cleanPath(projectPath);
+    rules.rootPrefix = rules.root + '/';
+    rules.defaults = parse(defaultRules(), QString());
+    rules.addGitIgnore(rules.root);
+
+    QFile projectFile(QDir(rules.root).filePath(".incodeignore"));
+    if (projectFile.open(QIODevice::ReadOnly)) {
+        rules.projectRules = parse(projectFile.readAll(), QString());
+    }
+    return rules;
+}
+
+void IgnoreRules::addGitIgnore(const QString &directoryPath)
+{
+    const QString directory = QDir::cleanPath(directoryPath);
+    QString relative;
+    if (!relativePath(directory, relative) || loadedDirectories.contains(directory))
+        return;
+    loadedDirectories.insert(directory);
+
+    QFile file(directory + "/.gitignore");
+    if (!file.open(QIODevice::ReadOnly))
+        return;
+    gitRules += parse(file.readAll(), relative.isEmpty() ? QString() : relative + '/');
+}
+
+void IgnoreRules::addGitIgnoresDownTo(const QString &directoryPath)
+{
+    QString relative;
+    if (!relativePath(QDir::cleanPath(directoryPath), relative))
+        return;
+    addGitIgnore(root);
+    QString current = root;
+    const QStringList parts = relative.split('/', Qt::SkipEmptyParts);
+    for (const QString &part : parts) {
+        current += '/' + part;
+        addGitIgnore(current);
+    }
+}
+
+bool IgnoreRules::ignoresEntry(const QString &path, bool isDirectory) const
+{
+    QString relative;
+    if (!relativePath(path, relative) || relative.isEmpty())
+        return false; // outside the root, or the root itself
+
+    // The most specific level that has an opinion wins
+    for (const QVector<Rule> *level : {&projectRules, &gitRules, &defaults}) {
+        const Verdict verdict = match(*level, relative, isDirectory);
+        if (verdict != NoMatch)
+            return verdict == Excluded;
+    }
+    return false;
+}
+
+bool IgnoreRules::isIgnored(const QString &path, bool isDirectory) const
+{
+    QString relative;
+    if (!relativePath(path, relative) || relative.isEmpty())
+        return false;
+
+    // A file inside an excluded directory is excluded with it
+    for (qsizetype slash = relative.indexOf('/'); slash >= 0; slash = relative.indexOf('/', slash + 1)) {
+        if (ignoresEntry(rootPrefix + relative.left(slash), true))
+            return true;
+    }
+    return ignoresEntry(path, isDirectory);
+}
+
+bool IgnoreRules::relativePath(const QString &path, QString &relative) const
+{
+    if (root.isEmpty())
+        return false;
+    if (path == root) {
+        relative.clear();
+        return true;
+    }
+    if (!path.startsWith(rootPrefix))
+        return false;
+    relative = path.mid(rootPrefix.size());
+    return true;
+}
+
+QVector<IgnoreRules::Rule> IgnoreRules::parse(const QByteArray &text, const QString &baseDir)
+{
+    QVector<Rule> rules;
+    const QList<QByteArray> lines = text.split('\n');
+    for (const QByteArray &rawLine : lines) {
+        QString line = QString::fromUtf8(rawLine);
+        if (line.endsWith('\r'))
+            line.chop(1);
+        // Trailing spaces don't count unless escaped
+        while (line.endsWith(' ') && !line.endsWith("\\ "))
+            line.chop(1);
+        if (line.isEmpty() || line.startsWith('#'))
+            continue;
+
+        Rule rule;
+        rule.baseDir = baseDir;
+        if (line.startsWith('!')) {
+            rule.negated = true;
+            line.remove(0, 1);
+        } else if (line.startsWith("\\!") || line.startsWith("\\#")) {
+            line.remove(0, 1);
+        }
+        if (line.endsWith('/')) {
+            rule.directoryOnly = true;
+            line.chop(1);
+        }
+        // A slash anywhere but at the end ties the pattern to baseDir;
+        // without one it matches a name at any depth
+        const bool anchored = line.contains('/');
+        if (line.startsWith('/'))
+            line.remove(0, 1);
+        if (line.isEmpty())
+            continue;
+
+        rule.pattern = QRegularExpression(QRegularExpression::anchoredPattern(patternToRegex(line, anchored)));
+        if (!rule.pattern.isValid()) {
+            qWarning() << "Skipping invalid ignore pattern:" << rawLine;
+            continue;
+        }
+        rule.pattern.optimize();
+        rules.append(rule);
+    }
+    return rules;
+}
+
+QString IgnoreRules::patternToRegex(const QString &glob, bool anchored)
+{
+    QString regex = anchored ? QString() : QStringLiteral("(?:.*/)?");
+    const qsizetype length = glob.size();
+    qsizetype i = 0;
+    while (i < length) {
+        const QChar c = glob.at(i);
+        if (c == '*') {
+            const bool doubleStar = i + 1 < length && glob.at(i + 1) == '*';
+            const bool startsComponent = i == 0 || glob.at(i - 1) == '/';
+            if (doubleStar && startsComponent && i + 2 == length) {
+                regex += ".*"; // "dir/**": everything inside
+                i += 2;
+            } else if (doubleStar && startsComponent && glob.at(i + 2) == '/') {
+                regex += "(?:.*/)?"; // "**/" : zero or more directories
+                i += 3;
+            } else {
+                regex += "[^/]*";
+                i += doubleStar ? 2 : 1;
+            }
+            continue;
+        }
+        if (c == '?') {
+            regex += "[^/]";
+        } else if (c == '[') {
+            qsizetype end = i + 1;
+            if (end < length && (glob.at(end) == '!' || glob.at(end) == '^'))
+                ++end;
+            if (end < length && glob.at(end) == ']')
+                ++end;
+            end = glob.indexOf(']', end);
+            if (end < 0) {
+                regex += "\\[";
+            } else {
+                QString set = glob.mid(i + 1, end - i - 1);
+                if (set.startsWith('!'))
+                    set[0] = '^';
+                set.replace("\\", "\\\\");
+                regex += '[' + set + ']';
+                i = end;
+            }
+        } else if (c == '\\' && i + 1 < length) {
+            regex += QRegularExpression::escape(QString(glob.at(i + 1)));
+            ++i;
+        } else {
+            regex += QRegularExpression::escape(QString(c));
+        }
+        ++i;
+    }
+    return regex;
+}
+
+IgnoreRules::Verdict IgnoreRules::match(const QVector<Rule> &rules, const QString &relativePath, bool isDirectory)
+{
+    // Later rules override earlier ones
+    for (auto rule = rules.crbegin(); rule != rules.crend(); ++rule) {
+        if (rule->directoryOnly && !isDirectory)
+            continue;
+        if (!relativePath.startsWith(rule->baseDir))
+            continue;
+        const QString path = rule->baseDir.isEmpty() ? relativePath : relativePath.mid(rule->baseDir.size());
+        if (rule->pattern.match(path).hasMatch())
+            return rule->negated ? Included : Excluded;
+    }
+    return NoMatch;
+}
@@ -0,0 +1,69 @@
+#ifndef INCODE_IGNORERULES_H
+#define INCODE_IGNORERULES_H
+
+#include <QString>
+#include <QStringList>
+#include <QByteArray>
+#include <QVector>
+#include <QSet>
+#include <QRegularExpression>
+
+// Decides which files and directories of a project are left out of
+// indexing, analysis and watching. Rules use .gitignore syntax and come from
+// three levels, each overriding the one before when it matches:
+//   1. built-in defaults (VCS and cache directories, vendor/, node_modules/,
+//      Laravel's storage/framework/ and bootstrap/cache/)
+//   2. the project's .gitignore files, deeper ones overriding shallower ones
+//   3. <project>/.incodeignore, whose "!pattern" lines re-include what the
+//      levels above exclude. Excluded directories are never entered, so to
+//      index one package: "!vendor/", "vendor/*", "!vendor/acme/".
+class IgnoreRules
+{
+public:
+    // Ignores nothing
+    IgnoreRules() = default;
+
+    // Defaults, the root .gitignore and .incodeignore of a project. Nested
+    // .gitignore files are added with addGitIgnore() as they are found.
+    static IgnoreRules forProject(const QString &projectPath);
+
+    QString rootPath() const { return root; }
+
+    // Adds directoryPath/.gitignore if there is one and it isn't loaded yet
+    void addGitIgnore(const QString &directoryPath);
+    // Same for every directory from the root down to directoryPath
+    void addGitIgnoresDownTo(const QString &directoryPath);
+
+    // Whether this entry itself is excluded; its parent directories are
+    // assumed not to be. Cheap enough to call for every entry of a walk.
+    bool ignoresEntry(const QString &path, bool isDirectory) const;
+    // Whether the entry or any directory above it is excluded
+    bool isIgnored(const QString &path, bool isDirectory) const;
+
+    // The built-in level, in .gitignore syntax
+    static const char *defaultRules();
+
+private:
+    struct Rule {
+        QRegularExpression pattern; // against the path relative to baseDir
+        QString baseDir;            // relative to the root, "" or ending in '/'
+        bool negated = false;
+        bool directoryOnly = false;
+    };
+    enum Verdict { NoMatch, Included, Excluded };
+
+    static QVector<Rule> parse(const QByteArray &text, const QString &baseDir);
+    static QString patternToRegex(const QString &glob, bool anchored);
+    static Verdict match(const QVector<Rule> &rules, const QString &relativePath, bool isDirectory);
+    // False if path is outside the root
+    bool relativePath(const QString &path, QString &relative) const;
+
+    QString root;
+    QString rootPrefix; // root + '/'
+    QVector<Rule> defaults;
+    QVector<Rule> gitRules;
+    QVector<Rule> projectRules;
+    QSet<QString> loadedDirectories;
+};
+
+#endif // INCODE_IGNORERULES_H
@@ -0,0 +1,19 @@
+#ifndef INCODE_INDEXSNAPSHOT_H
+#define INCODE_INDEXSNAPSHOT_H
+
+#include "SymbolTable.h"
+#include "CompletionIndex.h"
+#include "ReferenceIndex.h"
+#include "ComposerAutoloader.h"
+
+// One immutable generation of the project index. The indexer builds a new
+// snapshot in the background and publishes it as a whole, so everything a
+// reader gets from one snapshot is consistent.
+struct IndexSnapshot {
+    SymbolTable symbols;
+    CompletionIndex completions;
+    ReferenceIndex references;
+    ComposerAutoloader autoloader;
+};
+
+#endif // INCODE_INDEXSNAPSHOT_H
@@ -0,0 +1,125 @@
+#include "LargeFileIndex.h"
+#include <QtAlgorithms>
+#include <climits>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define INCODE_LINE_SCAN_SSE2
+#endif
+
+LargeFileIndex::~LargeFileIndex()
+{
+    if (data)
+        file.unmap(reinterpret_cast<uchar *>(const_cast<char *>(data)));
+}
+
+bool LargeFileIndex::open(const QString &filePath)
+{
+    file.setFileName(filePath);
+    if (!file.open(QIODevice::ReadOnly)) {
+        error = file.errorString();
+        return false;
+    }
+
+    dataSize = file.size();
+    // Mapping an empty file fails, and there is nothing to map anyway
+    if (dataSize > 0) {
+        data = reinterpret_cast<const char *>(file.map(0, dataSize));
+        if (!data) {
+            error = file.errorString();
+            dataSize = 0;
+            return false;
+        }
+    }
+
+    lineStarts.clear();
+    lineStarts.reserve(int(qMin<qint64>(dataSize / 32 + 1, 1 << 24)));
+    lineStarts.append(0);
+    appendLineStarts(data, dataSize, 0, lineStarts);
+
+    longest = 0;
+    for (int i = 0; i < lineStarts.size(); ++i) {
+        const qint64 end = i + 1 < lineStarts.size() ? lineStarts.at(i + 1) - 1 : dataSize;
+        longest = int(qMax<qint64>(longest, qMin<qint64>(end - lineStarts.at(i), INT_MAX)));
+    }
+    return true;
+}
+
+QString LargeFileIndex::errorString() const
+{
+    return error;
+}
+
+QString LargeFileIndex::filePath() const
+{
+    return file.fileName();
+}
+
+qint64 LargeFileIndex::size() const
+{
+    return dataSize;
+}
+
+int LargeFileIndex::lineCount() const
+{
+    return int(lineStarts.size());
+}
+
+int LargeFileIndex::longestLine() const
+{
+    return longest;
+}
+
+QString LargeFileIndex::line(int index, int maxBytes) const
+{
+    return QString::fromUtf8(rawLine(index, maxBytes));
+}
+
+QByteArray LargeFileIndex::rawLine(int index, int maxBytes) const
+{
+    if (index < 0 || index >= lineStarts.size())
+        return QByteArray();
+
+    const qint64 start = lineStarts.at(index);
+    qint64 end = index + 1 < lineStarts.size() ? lineStarts.at(index + 1) - 1 : dataSize;
+    if (end > start && data[end - 1] == '\r')
+        --end;
+    qint64 length = end - start;
+    if (maxBytes >= 0 && length > maxBytes) {
+        // Cut before a character, not inside its UTF-8 sequence
+        length = maxBytes;
+        while (length > 0 && (quint8(data[start + length]) & 0xC0) == 0x80)
+            --length;
+    }
+    return QByteArray::fromRawData(data + start, int(qMin<qint64>(length, INT_MAX)));
+}
+
+void LargeFileIndex::appendLineStarts(const char *data, qint64 size, qint64 base, QVector<qint64> &starts)
+{
+    qint64 pos = 0;
+#ifdef INCODE_LINE_SCAN_SSE2
+    // 64 bytes per step: four 16-byte compares folded into one bit mask,
+    // then one append per set bit
+    const __m128i newline = _mm_set1_epi8('\n');
+    for (; pos + 64 <= size; pos += 64) {
+        const __m128i *block = reinterpret_cast<const __m128i *>(data + pos);
+        const quint64 mask0 = quint32(_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128(block), newline)));
+        const quint64 mask1 = quint32(_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128(block + 1), newline)));
+        const quint64 mask2 = quint32(_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128(block + 2), newline)));
+        const quint64 mask3 = quint32(_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128(block + 3), newline)));
+        for (quint64 mask = mask0 | (mask1 << 16) | (mask2 << 32) | (mask3 << 48); mask; mask &= mask - 1) {
+            starts.append(base + pos + qCountTrailingZeroBits(mask) + 1);
+        }
+    }
+#endif
+    // The tail, or everything where SSE2 isn't available (memchr is
+    // vectorized by the C library there)
+    while (pos < size) {
+        const void *hit = std::memchr(data + pos, '\n', size_t(size - pos));
+        if (!hit)
+            break;
+        pos = static_cast<const char *>(hit) - data + 1;
+        starts.append(base + pos);
+    }
+}
@@ -0,0 +1,54 @@
+#ifndef INCODE_LARGEFILEINDEX_H
+#define INCODE_LARGEFILEINDEX_H
+
+#include <QByteArray>
+#include <QFile>
+#include <QString>
+#include <QVector>
+
+// Read-only access by line to a file too large for a QTextDocument. The
+// file is memory-mapped and only the offset where each line starts is
+// kept, 8 bytes a line, so memory follows the line count rather than the
+// file size and any line is reached in constant time. The offsets come
+// from a vectorized newline scan.
+//
+// The file must not be truncated while it is open: reading a mapped page
+// past the new end faults. Appending (a growing log) is harmless; the new
+// lines just aren't visible.
+class LargeFileIndex
+{
+public:
+    LargeFileIndex() = default;
+    ~LargeFileIndex();
+
+    // Maps the file and indexes its lines; on failure errorString() says why
+    bool open(const QString &filePath);
+    QString errorString() const;
+
+    QString filePath() const;
+    qint64 size() const;
+    int lineCount() const;
+    // Length in bytes of the longest line, line break excluded
+    int longestLine() const;
+
+    // A line (0-based) without its line break, decoded as UTF-8. Only the
+    // first maxBytes are kept, less if that would split a character.
+    QString line(int index, int maxBytes = -1) const;
+    // The same bytes undecoded; they point into the mapping, no copy is made
+    QByteArray rawLine(int index, int maxBytes = -1) const;
+
+    // Appends base + the offset just past every '\n' in data[0, size)
+    static void appendLineStarts(const char *data, qint64 size, qint64 base, QVector<qint64> &starts);
+
+private:
+    Q_DISABLE_COPY(LargeFileIndex)
+
+    QFile file;
+    const char *data = nullptr;
+    qint64 dataSize = 0;
+    QVector<qint64> lineStarts; // lineStarts[0] == 0
+    int longest = 0;
+    QString error;
+};
+
+#endif // INCODE_LARGEFILEINDEX_H
@@ -0,0 +1,156 @@
+#include "LatencyProfiler.h"
+#include <QCoreApplication>
+#include <QFile>
+#include <QtAlgorithms>
+
+LatencyProfiler::LatencyProfiler()
+{
+    clock.start();
+}
+
+LatencyProfiler &LatencyProfiler::instance()
+{
+    static LatencyProfiler profiler;
+    return profiler;
+}
+
+void LatencyProfiler::setEnabled(bool enable)
+{
+    if (enable && trace.isEmpty())
+        trace.resize(TraceCapacity);
+    enabled = enable;
+    keyPressStart = -1;
+}
+
+void LatencyProfiler::reset()
+{
+    for (Histogram &histogram : histograms) {
+        histogram = Histogram();
+    }
+    traceNext = 0;
+    traceWrapped = false;
+    keyPressStart = -1;
+}
+
+void LatencyProfiler::record(Metric metric, qint64 startNsecs, qint64 endNsecs)
+{
+    const qint64 duration = endNsecs - startNsecs;
+    Histogram &histogram = histograms[metric];
+    ++histogram.buckets[bucketOf(duration)];
+    ++histogram.count;
+    histogram.max = qMax(histogram.max, duration);
+
+    trace[traceNext] = TraceEvent{startNsecs, duration, metric};
+    if (++traceNext == TraceCapacity) {
+        traceNext = 0;
+        traceWrapped = true;
+    }
+}
+
+void LatencyProfiler::keyPressed()
+{
+    if (enabled && keyPressStart < 0)
+        keyPressStart = now();
+}
+
+void LatencyProfiler::painted()
+{
+    if (enabled && keyPressStart >= 0) {
+        record(KeyToPaint, keyPressStart, now());
+        keyPressStart = -1;
+    }
+}
+
+LatencyProfiler::Summary LatencyProfiler::summary(Metric metric) const
+{
+    const Histogram &histogram = histograms[metric];
+    Summary result;
+    result.count = histogram.count;
+    result.max = histogram.max;
+    // Bucket middles can overshoot the largest duration actually seen
+    result.p50 = qMin(percentile(histogram, 0.5), histogram.max);
+    result.p99 = qMin(percentile(histogram, 0.99), histogram.max);
+    return result;
+}
+
+const char *LatencyProfiler::name(Metric metric)
+{
+    static const char *const Names[MetricCount] = {
+        "keyPress", "completion", "highlightBlock", "currentLine", "lineNumbers", "viewportPaint", "keyToPaint"
+    };
+    return Names[metric];
+}
+
+int LatencyProfiler::bucketOf(qint64 nsecs)
+{
+    if (nsecs < SubBuckets)
+        return int(qMax<qint64>(nsecs, 0));
+    const int exponent = 63 - int(qCountLeadingZeroBits(quint64(nsecs)));
+    if (exponent > MaxExponent)
+        return BucketCount - 1;
+    const int shift = exponent - SubBucketBits;
+    return (shift + 1) * SubBuckets + int((nsecs >> shift) & (SubBuckets - 1));
+}
+
+qint64 LatencyProfiler::bucketValue(int bucket)
+{
+    if (bucket < SubBuckets)
+        return bucket;
+    const int shift = bucket / SubBuckets - 1;
+    const qint64 low = qint64(SubBuckets + bucket % SubBuckets) << shift;
+    return low + (qint64(1) << shift) / 2;
+}
+
+qint64 LatencyProfiler::percentile(const Histogram &histogram, double fraction) const
+{
+    if (histogram.count == 0)
+        return 0;
+    const qint64 rank = qMax<qint64>(1, qint64(histogram.count * fraction + 0.5));
+    qint64 seen = 0;
+    for (int bucket = 0; bucket < BucketCount; ++bucket) {
+        seen += histogram.buckets[bucket];
+        if (seen >= rank)
+            return bucketValue(bucket);
+    }
+    return histogram.max;
+}
+
+QByteArray LatencyProfiler::chromeTrace() const
+{
+    // Written by hand rather than through QJsonDocument: a full ring is
+    // 65k events
+    const QByteArray pid = QByteArray::number(QCoreApplication::applicationPid());
+    QByteArray json;
+    json.reserve(128 + (traceWrapped ? TraceCapacity : traceNext) * 110);
+    json += "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+    json += "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":" + pid + ",\"tid\":1,\"args\":{\"name\":\"GUI\"}},\n";
+    json += "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":" + pid + ",\"tid\":2,\"args\":{\"name\":\"Keystroke to paint\"}}";
+
+    // Oldest first. KeyToPaint intervals get a track of their own: they
+    // span the events of the GUI thread rather than nest inside them.
+    const int count = traceWrapped ? TraceCapacity : traceNext;
+    const int first = traceWrapped ? traceNext : 0;
+    for (int i = 0; i < count; ++i) {
+        const TraceEvent &event = trace.at((first + i) % TraceCapacity);
+        json += ",\n{\"name\":\"";
+        json += name(event.metric);
+        json += "\",\"cat\":\"editor\",\"ph\":\"X\",\"ts\":";
+        json += QByteArray::number(double(event.start) / 1000, 'f', 3);
+        json += ",\"dur\":";
+        json += QByteArray::number(double(event.duration) / 1000, 'f', 3);
+        json += ",\"pid\":" + pid + (event.metric == KeyToPaint ? ",\"tid\":2}" : ",\"tid\":1}");
+    }
+    json += "\n]}\n";
+    return json;
+}
+
+bool LatencyProfiler::writeChromeTrace(const QString &filePath, QString *errorString) const
+{
+    QFile file(filePath);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate) || file.write(chromeTrace()) < 0) {
+        if (errorString)
+            *errorString = file.errorString();
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,114 @@
+#ifndef INCODE_LATENCYPROFILER_H
+#define INCODE_LATENCYPROFILER_H
+
+#include <QByteArray>
+#include <QElapsedTimer>
+#include <QString>
+#include <QVector>
+
+// Where the time between a keystroke and its paint goes. Each stage is
+// timed into a fixed log-linear histogram (16 buckets per power of two, so
+// percentiles are within about 6%) and into a ring of recent events that
+// can be exported as a Chrome trace. Recording is off until enabled; off,
+// a Scope costs a branch. GUI thread only.
+class LatencyProfiler
+{
+public:
+    enum Metric : quint8 {
+        KeyPress,       // CodeEditor::keyPressEvent, completions included
+        Completion,     // filtering completions for the typed prefix
+        HighlightBlock, // coloring one block
+        CurrentLine,    // the current line highlight
+        LineNumbers,    // painting the line number area
+        ViewportPaint,  // painting the editor's text
+        KeyToPaint,     // from a key press to the end of the next text paint
+        MetricCount
+    };
+
+    struct Summary {
+        qint64 count = 0;
+        qint64 p50 = 0; // nanoseconds
+        qint64 p99 = 0;
+        qint64 max = 0;
+    };
+
+    // Times its own lifetime into a metric
+    class Scope
+    {
+    public:
+        explicit Scope(Metric metric)
+            : metric(metric), start(instance().isEnabled() ? instance().now() : -1) {}
+        ~Scope()
+        {
+            if (start >= 0)
+                instance().record(metric, start, instance().now());
+        }
+
+    private:
+        Q_DISABLE_COPY(Scope)
+        Metric metric;
+        qint64 start;
+    };
+
+    static LatencyProfiler &instance();
+
+    bool isEnabled() const { return enabled; }
+    void setEnabled(bool enable);
+    // Clears the histograms and the trace
+    void reset();
+
+    // Nanoseconds since the profiler was created
+    qint64 now() const { return clock.nsecsElapsed(); }
+    void record(Metric metric, qint64 startNsecs, qint64 endNsecs);
+
+    // A key press opens a KeyToPaint interval (if none is open) that the
+    // next text paint closes
+    void keyPressed();
+    void painted();
+
+    Summary summary(Metric metric) const;
+    static const char *name(Metric metric);
+
+    // The recorded events in Chrome's trace event format, for
+    // chrome://tracing or Perfetto
+    QByteArray chromeTrace() const;
+    bool writeChromeTrace(const QString &filePath, QString *errorString = nullptr) const;
+
+private:
+    LatencyProfiler();
+
+    static const int SubBucketBits = 4;
+    static const int SubBuckets = 1 << SubBucketBits;
+    // Durations up to 2^MaxExponent ns (18 minutes); longer ones land in the last bucket
+    static const int MaxExponent = 40;
+    static const int BucketCount = (MaxExponent - SubBucketBits + 2) * SubBuckets;
+    // Events kept for the trace, the latest ones
+    static const int TraceCapacity = 1 << 16;
+
+    struct Histogram {
+        quint32 buckets[BucketCount] = {};
+        qint64 count = 0;
+        qint64 max = 0;
+    };
+
+    struct TraceEvent {
+        qint64 start;
+        qint64 duration;
+        Metric metric;
+    };
+
+    static int bucketOf(qint64 nsecs);
+    // Middle of the range of durations a bucket holds
+    static qint64 bucketValue(int bucket);
+    qint64 percentile(const Histogram &histogram, double fraction) const;
+
+    QElapsedTimer clock;
+    bool enabled = false;
+    Histogram histograms[MetricCount];
+    QVector<TraceEvent> trace; // ring, allocated when first enabled
+    int traceNext = 0;
+    bool traceWrapped = false;
+    qint64 keyPressStart = -1; // open KeyToPaint interval
+};
+
+#endif // INCODE_LATENCYPROFILER_H
@@ -1,6 +1,12 @@
 #include "MainWindow.h"
 #include "SimpleSymbolIndexer.h"
 #include "CodeAnalyzer.h"
+#include "ProjectWatcher.h"
+#include "RepetitionModel.h"
+#include "ComposerAutoloader.h"
+#include "widgets/LargeFileViewer.h"
+#include "FileLoader.h"
+#include "LatencyProfiler.h"
 #include <QTabWidget>
 #include <QTreeView>
 #include <QFileSystemModel>
@@ -11,6 +17,7 @@
 #include <QMenu>
 #include <QFileDialog>
 #include <QMessageBox>
+#include <QInputDialog>
 #include <QFile>
 #include <QTextStream>
 #include <QDockWidget>
@@ -18,8 +25,12 @@
 #include <QDebug>
 #include <QDir>
 #include <QTextBlock>
+#include <QListWidget>
+#include <QElapsedTimer>
+#include <QTimer>
 
 #include <QStatusBar>
+#include <QToolButton>
 
 MainWindow::MainWindow(QWidget *parent)
     : QMainWindow(parent)
@@ -48,15 +59,18 @@ MainWindow::~MainWindow()
     // Stop and wait for the indexing thread to finish
     if (indexingThread && indexingThread->isRunning()) {
         qDebug() << "Quitting indexing thread...";
+        static_cast<SimpleSymbolIndexer*>(symbolProvider)->cancelIndexing(); // Don't wait for a full project index
         indexingThread->quit();
         indexingThread->wait(); // Wait for the thread to finish
         qDebug() << "Indexing thread finished.";
     }
 
-    // Delete objects that were moved to the thread or managed by it
-    // QObject::deleteLater connections handle deletion, but explicit deletion here
-    // ensures they are cleaned up if the thread was already quit.
-    delete codeAnalyzer;   // Delete the code analyzer
+    // Same for the analysis thread; the analyzer is deleted by its finished() connection
+    if (analysisThread && analysisThread->isRunning()) {
+        codeAnalyzer->cancelAnalysis();
+        analysisThread->quit();
+        analysisThread->wait();
+    }
 
     qDebug() << "MainWindow destructor finished.";
 }
@@ -84,6 +98,8 @@ void MainWindow::createWidgets()
 
     terminalInput = new QLineEdit(this);
 
+    referencesList = new QListWidget(this);
+
     terminalProcess = new QProcess(this);
     terminalProcess->setProcessChannelMode(QProcess::MergedChannels);
     terminalProcess->start("/bin/bash");
@@ -96,18 +112,58 @@ void MainWindow::createWidgets()
     symbolProvider = new SimpleSymbolIndexer(); // Instantiate the simple indexer
     indexingThread = new QThread(this);
     static_cast<SimpleSymbolIndexer*>(symbolProvider)->moveToThread(indexingThread);
+    // Opening a project that was analyzed before also tokenizes the folders
+    // Analyze Code looks at, from the same file reads
+    auto analysisConsumer = std::make_shared<AnalysisScanConsumer>(QStringList() << "app" << "resources");
+    analysisConsumer->setRefreshOnly(true);
+    static_cast<SimpleSymbolIndexer*>(symbolProvider)->addScanConsumer(analysisConsumer);
 
     // Connect signals to start work in the thread
     connect(static_cast<SimpleSymbolIndexer*>(symbolProvider), &SimpleSymbolIndexer::startIndexing, static_cast<SimpleSymbolIndexer*>(symbolProvider), &SimpleSymbolIndexer::doIndexDirectory);
+    connect(static_cast<SimpleSymbolIndexer*>(symbolProvider), &SimpleSymbolIndexer::startReindexing, static_cast<SimpleSymbolIndexer*>(symbolProvider), &SimpleSymbolIndexer::doReindexFiles);
+    connect(static_cast<SimpleSymbolIndexer*>(symbolProvider), &SimpleSymbolIndexer::startLazyIndexing, static_cast<SimpleSymbolIndexer*>(symbolProvider), &SimpleSymbolIndexer::doIndexLazyFiles);
     connect(indexingThread, &QThread::finished, static_cast<SimpleSymbolIndexer*>(symbolProvider), &QObject::deleteLater);
     connect(indexingThread, &QThread::finished, indexingThread, &QObject::deleteLater);
 
     // Connect progress signals
     connect(static_cast<SimpleSymbolIndexer*>(symbolProvider), &SimpleSymbolIndexer::indexingProgress, this, &MainWindow::onIndexingProgress);
     connect(static_cast<SimpleSymbolIndexer*>(symbolProvider), &SimpleSymbolIndexer::indexingFinished, this, &MainWindow::onIndexingFinished);
+    connect(static_cast<SimpleSymbolIndexer*>(symbolProvider), &SimpleSymbolIndexer::indexingCancelled, this, &MainWindow::onIndexingCancelled);
 
     indexingThread->start(); // Start the thread
-    codeAnalyzer = new CodeAnalyzer(this);         // Instantiate the code analyzer
+
+    // Keep the index current when files change on disk (branch switches, generators)
+    projectWatcher = new ProjectWatcher(this);
+    connect(projectWatcher, &ProjectWatcher::filesChanged, static_cast<SimpleSymbolIndexer*>(symbolProvider), &SimpleSymbolIndexer::startReindexing);
+    // An edited .gitignore or .incodeignore can add or drop any file
+    connect(projectWatcher, &ProjectWatcher::ignoreRulesChanged, this, [this]() {
+        indexingStatusLabel->setText("Indexing...");
+        indexingProgressBar->setValue(0);
+        indexingProgressBar->show();
+        cancelIndexingButton->show();
+        static_cast<SimpleSymbolIndexer*>(symbolProvider)->indexDirectory(projectWatcher->rootPath(), openFilePaths());
+    });
+
+    // Files are read and decoded in the background and streamed into their tabs
+    fileLoader = new FileLoader(this);
+
+    // Repetition analysis runs on its own thread and fans out to a worker pool
+    codeAnalyzer = new CodeAnalyzer();         // Instantiate the code analyzer
+    analysisThread = new QThread(this);
+    codeAnalyzer->moveToThread(analysisThread);
+    connect(codeAnalyzer, &CodeAnalyzer::startAnalysis, codeAnalyzer, &CodeAnalyzer::doAnalyzePaths);
+    connect(analysisThread, &QThread::finished, codeAnalyzer, &QObject::deleteLater);
+    analysisThread->start();
+
+    // Results are grouped by clone class; snippets are read when a tooltip shows
+    repetitionModel = new RepetitionModel(this);
+    repetitionModel->setSnippetProvider([this](const QString &filePath, int startLine, int endLine) {
+        return snippetAt(filePath, startLine, endLine);
+    });
+    repetitionsView = new QTreeView(this);
+    repetitionsView->setModel(repetitionModel);
+    repetitionsView->setHeaderHidden(true);
+    repetitionsView->setUniformRowHeights(true);
 
     qDebug() << "Terminal setup complete.";
     qDebug() << "createWidgets finished.";
@@ -135,6 +191,19 @@ void MainWindow::setupLayout()
     terminalDock->setWidget(terminalWidget);
     addDockWidget(Qt::BottomDockWidgetArea, terminalDock);
 
+    // References dock, filled by Find References
+    referencesDock = new QDockWidget(tr("References"), this);
+    referencesDock->setWidget(referencesList);
+    addDockWidget(Qt::BottomDockWidgetArea, referencesDock);
+    tabifyDockWidget(terminalDock, referencesDock);
+
+    // Repetitions dock, filled while analysis runs
+    repetitionsDock = new QDockWidget(tr("Repetitions"), this);
+    repetitionsDock->setWidget(repetitionsView);
+    addDockWidget(Qt::BottomDockWidgetArea, repetitionsDock);
+    tabifyDockWidget(terminalDock, repetitionsDock);
+    terminalDock->raise();
+
     // Status bar for indexing progress
     indexingStatusLabel = new QLabel("Ready");
     statusBar()->addWidget(indexingStatusLabel);
@@ -146,6 +215,38 @@ void MainWindow::setupLayout()
     indexingProgressBar->setFixedWidth(200);
     statusBar()->addWidget(indexingProgressBar);
 
+    cancelIndexingButton = new QToolButton();
+    cancelIndexingButton->setText("Cancel");
+    cancelIndexingButton->setToolTip("Stop indexing");
+    cancelIndexingButton->hide();
+    statusBar()->addWidget(cancelIndexingButton);
+    connect(cancelIndexingButton, &QToolButton::clicked, this, [this]() {
+        static_cast<SimpleSymbolIndexer*>(symbolProvider)->cancelIndexing();
+    });
+
+    // Status bar for analysis progress
+    analysisProgressBar = new QProgressBar();
+    analysisProgressBar->setRange(0, 100);
+    analysisProgressBar->setFormat("Analyzing %p%");
+    analysisProgressBar->setFixedWidth(200);
+    analysisProgressBar->hide();
+    statusBar()->addWidget(analysisProgressBar);
+
+    cancelAnalysisButton = new QToolButton();
+    cancelAnalysisButton->setText("Cancel");
+    cancelAnalysisButton->setToolTip("Stop code analysis");
+    cancelAnalysisButton->hide();
+    statusBar()->addWidget(cancelAnalysisButton);
+    connect(cancelAnalysisButton, &QToolButton::clicked, codeAnalyzer, &CodeAnalyzer::cancelAnalysis, Qt::DirectConnection);
+
+    // Editor latency percentiles, shown while profiling (View > Latency Overlay)
+    latencyLabel = new QLabel();
+    latencyLabel->hide();
+    statusBar()->addPermanentWidget(latencyLabel);
+    latencyTimer = new QTimer(this);
+    latencyTimer->setInterval(500);
+    connect(latencyTimer, &QTimer::timeout, this, &MainWindow::updateLatencyOverlay);
+
     qDebug() << "setupLayout finished.";
 }
 
@@ -177,6 +278,19 @@ void MainWindow::createMenus()
     QAction *analyzeCodeAction = new QAction("Analyze Code Repetitions", this);
     connect(analyzeCodeAction, &QAction::triggered, this, &MainWindow::analyzeCode);
     analyzeMenu->addAction(analyzeCodeAction);
+    QAction *similarFunctionsAction = new QAction("Find Similar Functions", this);
+    connect(similarFunctionsAction, &QAction::triggered, this, &MainWindow::findSimilarFunctions);
+    analyzeMenu->addAction(similarFunctionsAction);
+
+    QMenu *viewMenu = menuBar()->addMenu("&View");
+    QAction *latencyOverlayAction = new QAction("Latency Overlay", this);
+    latencyOverlayAction->setCheckable(true);
+    latencyOverlayAction->setToolTip("Time each step from keystroke to paint and show percentiles in the status bar");
+    connect(latencyOverlayAction, &QAction::toggled, this, &MainWindow::setLatencyOverlayVisible);
+    viewMenu->addAction(latencyOverlayAction);
+    QAction *exportTraceAction = new QAction("Export Latency Trace...", this);
+    connect(exportTraceAction, &QAction::triggered, this, &MainWindow::exportLatencyTrace);
+    viewMenu->addAction(exportTraceAction);
 
     qDebug() << "createMenus finished.";
 }
@@ -188,7 +302,15 @@ void MainWindow::setupConnections()
     connect(tabWidget, &QTabWidget::tabCloseRequested, this, &MainWindow::onTabCloseRequested);
     connect(terminalProcess, &QProcess::readyReadStandardOutput, this, &MainWindow::readTerminalOutput);
     connect(terminalInput, &QLineEdit::returnPressed, this, &MainWindow::handleTerminalCommand);
+    connect(codeAnalyzer, &CodeAnalyzer::analysisProgress, this, &MainWindow::onAnalysisProgress);
+    connect(codeAnalyzer, &CodeAnalyzer::partialResults, this, &MainWindow::onPartialResults);
     connect(codeAnalyzer, &CodeAnalyzer::analysisFinished, this, &MainWindow::onAnalysisFinished);
+    connect(codeAnalyzer, &CodeAnalyzer::analysisCancelled, this, &MainWindow::onAnalysisCancelled);
+    connect(fileLoader, &FileLoader::chunkLoaded, this, &MainWindow::onFileChunkLoaded);
+    connect(fileLoader, &FileLoader::loadFinished, this, &MainWindow::onFileLoaded);
+    connect(fileLoader, &FileLoader::loadFailed, this, &MainWindow::onFileLoadFailed);
+    connect(referencesList, &QListWidget::itemActivated, this, &MainWindow::onLocationActivated);
+    connect(repetitionsView, &QTreeView::activated, this, &MainWindow::onRepetitionActivated);
     qDebug() << "setupConnections finished.";
 }
 
@@ -197,26 +319,112 @@ void MainWindow::newFile()
     CodeEditor *editor = new CodeEditor(symbolProvider);
     int index = tabWidget->addTab(editor, "Untitled");
     tabWidget->setCurrentIndex(index);
+    connectEditor(editor);
+}
+
+void MainWindow::connectEditor(CodeEditor *editor)
+{
     connect(editor, &CodeEditor::goToDefinitionRequested, this, &MainWindow::goToDefinition);
+    connect(editor, &CodeEditor::findReferencesRequested, this, &MainWindow::findReferences);
 }
 
 void MainWindow::openFile(const QString &filePath)
 {
     if (filePath.isEmpty()) return;
 
-    QFile file(filePath);
-    if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
-        QMessageBox::warning(this, "Error", "Could not open file: " + filePath);
+    // Switch to the file if it is already open
+    for (int i = 0; i < tabWidget->count(); ++i) {
+        CodeEditor *openEditor = qobject_cast<CodeEditor*>(tabWidget->widget(i));
+        LargeFileViewer *openViewer = qobject_cast<LargeFileViewer*>(tabWidget->widget(i));
+        if ((openEditor && openEditor->filePath() == filePath) || (openViewer && openViewer->filePath() == filePath)) {
+            tabWidget->setCurrentIndex(i);
+            return;
+        }
+    }
+
+    // Dumps and logs would take several times their size in a QTextDocument
+    if (QFileInfo(filePath).size() >= LargeFileViewer::MinimumFileSize) {
+        LargeFileViewer *viewer = new LargeFileViewer;
+        if (!viewer->openFile(filePath)) {
+            QMessageBox::warning(this, "Error", "Could not open file: " + filePath + "\n" + viewer->errorString());
+            delete viewer;
+            return;
+        }
+        int index = tabWidget->addTab(viewer, QFileInfo(filePath).fileName() + " (read-only)");
+        tabWidget->setTabToolTip(index, filePath);
+        tabWidget->setCurrentIndex(index);
+        projectWatcher->addOpenFile(filePath);
         return;
     }
 
+    // The tab opens empty and the text streams in from fileLoader
     CodeEditor *editor = new CodeEditor(symbolProvider);
-    editor->setPlainText(file.readAll());
-    file.close();
+    editor->setFilePath(filePath);
+    editor->beginLoading();
 
     int index = tabWidget->addTab(editor, QFileInfo(filePath).fileName());
+    tabWidget->setTabToolTip(index, filePath);
     tabWidget->setCurrentIndex(index);
-    connect(editor, &CodeEditor::goToDefinitionRequested, this, &MainWindow::goToDefinition);
+    connectEditor(editor);
+    projectWatcher->addOpenFile(filePath);
+    loadingEditors.insert(fileLoader->load(filePath), editor);
+}
+
+void MainWindow::onFileChunkLoaded(int job, const QString &text)
+{
+    if (CodeEditor *editor = loadingEditors.value(job)) {
+        editor->appendLoadedText(text);
+    }
+}
+
+void MainWindow::onFileLoaded(int job)
+{
+    if (CodeEditor *editor = loadingEditors.take(job)) {
+        editor->finishLoading();
+    }
+}
+
+void MainWindow::onFileLoadFailed(int job, const QString &errorString)
+{
+    CodeEditor *editor = loadingEditors.take(job);
+    if (!editor) return;
+
+    QMessageBox::warning(this, "Error", "Could not open file: " + editor->filePath() + "\n" + errorString);
+    projectWatcher->removeOpenFile(editor->filePath());
+    const int index = tabWidget->indexOf(editor);
+    if (index >= 0) {
+        tabWidget->removeTab(index);
+    }
+    delete editor;
+}
+
+QStringList MainWindow::openFilePaths() const
+{
+    // Current tab first
+    QStringList paths;
+    CodeEditor *current = qobject_cast<CodeEditor*>(tabWidget->currentWidget());
+    if (current && !current->filePath().isEmpty()) {
+        paths.append(current->filePath());
+    }
+    for (int i = 0; i < tabWidget->count(); ++i) {
+        CodeEditor *editor = qobject_cast<CodeEditor*>(tabWidget->widget(i));
+        if (editor && editor != current && !editor->filePath().isEmpty()) {
+            paths.append(editor->filePath());
+        }
+    }
+    return paths;
+}
+
+void MainWindow::openFileAtLine(const QString &filePath, int lineNumber)
+{
+    openFile(filePath);
+    CodeEditor *editor = qobject_cast<CodeEditor*>(tabWidget->currentWidget());
+    if (editor && editor->filePath() == filePath) {
+        editor->goToLine(lineNumber);
+    } else if (LargeFileViewer *viewer = qobject_cast<LargeFileViewer*>(tabWidget->currentWidget())) {
+        if (viewer->filePath() == filePath)
+            viewer->goToLine(lineNumber);
+    }
 }
 
 void MainWindow::openFile()
@@ -235,9 +443,11 @@ void MainWindow::openFolder()
         indexingStatusLabel->setText("Indexing...");
         indexingProgressBar->setValue(0);
         indexingProgressBar->show();
+        cancelIndexingButton->show();
 
-        // Emit signal to start indexing in the worker thread
-        emit static_cast<SimpleSymbolIndexer*>(symbolProvider)->startIndexing(dirPath);
+        // Replaces any indexing still running for the previous folder
+        static_cast<SimpleSymbolIndexer*>(symbolProvider)->indexDirectory(dirPath, openFilePaths());
+        projectWatcher->setRootPath(dirPath);
     }
 }
 
@@ -245,11 +455,11 @@ void MainWindow::saveFile()
 {
     if (tabWidget->count() == 0) return;
 
-    QTextEdit *currentEditor = qobject_cast<QTextEdit*>(tabWidget->currentWidget());
+    // Large files open in a read-only viewer
+    CodeEditor *currentEditor = qobject_cast<CodeEditor*>(tabWidget->currentWidget());
     if (!currentEditor) return;
 
-    // Simplified save logic. Needs improvement to track file paths.
-    QString filePath = QFileDialog::getSaveFileName(this, "Save File");
+    QString filePath = QFileDialog::getSaveFileName(this, "Save File", currentEditor->filePath());
     if (filePath.isEmpty()) return;
 
     QFile file(filePath);
@@ -261,8 +471,17 @@ void MainWindow::saveFile()
     QTextStream out(&file);
     out << currentEditor->toPlainText();
     file.close();
-
+    // Written in place, which the watcher's directory events don't show
+    projectWatcher->fileWritten(filePath);
+
+    // Saved under another name: the tab now shows that file
+    if (filePath != currentEditor->filePath()) {
+        projectWatcher->removeOpenFile(currentEditor->filePath());
+        currentEditor->setFilePath(filePath);
+        projectWatcher->addOpenFile(filePath);
+    }
     tabWidget->setTabText(tabWidget->currentIndex(), QFileInfo(filePath).fileName());
+    tabWidget->setTabToolTip(tabWidget->currentIndex(), filePath);
 }
 
 void MainWindow::onFileTreeDoubleClicked(const QModelIndex &index)
@@ -276,6 +495,18 @@ void MainWindow::onFileTreeDoubleClicked(const QModelIndex &index)
 void MainWindow::onTabCloseRequested(int index)
 {
     QWidget *widget = tabWidget->widget(index);
+    for (auto it = loadingEditors.begin(); it != loadingEditors.end(); ++it) {
+        if (it.value() == widget) {
+            fileLoader->cancel(it.key());
+            loadingEditors.erase(it);
+            break;
+        }
+    }
+    if (CodeEditor *editor = qobject_cast<CodeEditor*>(widget)) {
+        projectWatcher->removeOpenFile(editor->filePath());
+    } else if (LargeFileViewer *viewer = qobject_cast<LargeFileViewer*>(widget)) {
+        projectWatcher->removeOpenFile(viewer->filePath());
+    }
     tabWidget->removeTab(index);
     delete widget;
 }
@@ -304,19 +535,92 @@ void MainWindow::keyPressEvent(QKeyEvent *event)
 void MainWindow::goToDefinition(const QString &symbolName)
 {
     qDebug() << "Attempting to go to definition for:" << symbolName;
-    SymbolLocation location = symbolProvider->findSymbolLocation(symbolName);
-    if (!location.filePath.isEmpty() && location.lineNumber != -1) {
-        qDebug() << "Found symbol at:" << location.filePath << ":" << location.lineNumber;
-        // TODO: Open file and navigate to line. This requires a custom editor widget.
-        openFile(location.filePath); // For now, just open the file
-        // In a real scenario, we'd also scroll to the line number.
-    } else {
+
+    // Class names are resolved like PHP would, through the file's namespace
+    // and use statements and then Composer's autoload rules, which also
+    // reach vendor/ classes
+    if (CodeEditor *editor = qobject_cast<CodeEditor*>(tabWidget->currentWidget())) {
+        const QString qualifiedName = ComposerAutoloader::qualify(symbolName, editor->toPlainText());
+        const SymbolLocation resolved = symbolProvider->resolveClass(qualifiedName);
+        if (resolved.lineNumber > 0) {
+            qDebug() << "Resolved" << qualifiedName << "to" << resolved.filePath << ":" << resolved.lineNumber;
+            openFileAtLine(resolved.filePath, resolved.lineNumber);
+            return;
+        }
+    }
+
+    // Otherwise any definition of the bare name
+    const QString name = symbolName.section('\\', -1);
+    const QList<SymbolLocation> locations = symbolProvider->findSymbolLocations(name);
+    if (locations.isEmpty()) {
         qDebug() << "Symbol not found:" << symbolName;
         QMessageBox::information(this, "Go to Definition", "Symbol '" + symbolName + "' not found.");
+        return;
+    }
+
+    SymbolLocation location = locations.first();
+    if (locations.size() > 1) {
+        // Ambiguous name (e.g. a method defined by many classes): let the user pick
+        QStringList choices;
+        for (const SymbolLocation &candidate : locations) {
+            choices << QString("%1:%2").arg(candidate.filePath).arg(candidate.lineNumber);
+        }
+        bool ok = false;
+        const QString choice = QInputDialog::getItem(this, "Go to Definition",
+                                                     QString("'%1' is defined in %2 places:").arg(symbolName).arg(locations.size()),
+                                                     choices, 0, false, &ok);
+        if (!ok) return;
+        location = locations.at(choices.indexOf(choice));
+    }
+
+    qDebug() << "Found symbol at:" << location.filePath << ":" << location.lineNumber;
+    openFileAtLine(location.filePath, location.lineNumber);
+}
+
+void MainWindow::findReferences(const QString &symbolName)
+{
+    QElapsedTimer timer;
+    timer.start();
+    const QList<SymbolLocation> references = symbolProvider->findReferences(symbolName);
+    const qint64 elapsed = timer.elapsed();
+
+    referencesList->clear();
+    const QDir root(fileModel->rootPath());
+    for (const SymbolLocation &reference : references) {
+        QListWidgetItem *item = new QListWidgetItem(QString("%1:%2").arg(root.relativeFilePath(reference.filePath)).arg(reference.lineNumber), referencesList);
+        item->setData(Qt::UserRole, reference.filePath);
+        item->setData(Qt::UserRole + 1, reference.lineNumber);
     }
+
+    referencesDock->setWindowTitle(QString("References: %1 (%2 found in %3 ms)").arg(symbolName).arg(references.size()).arg(elapsed));
+    referencesDock->show();
+    referencesDock->raise();
+}
+
+void MainWindow::onLocationActivated(QListWidgetItem *item)
+{
+    openFileAtLine(item->data(Qt::UserRole).toString(), item->data(Qt::UserRole + 1).toInt());
+}
+
+void MainWindow::onRepetitionActivated(const QModelIndex &index)
+{
+    // Group rows just expand
+    if (!index.parent().isValid())
+        return;
+    openFileAtLine(index.data(RepetitionModel::FilePathRole).toString(), index.data(RepetitionModel::StartLineRole).toInt());
 }
 
 void MainWindow::analyzeCode()
+{
+    runAnalysis(CodeAnalyzer::CloneAnalysis);
+}
+
+void MainWindow::findSimilarFunctions()
+{
+    runAnalysis(CodeAnalyzer::SimilarityAnalysis);
+}
+
+void MainWindow::runAnalysis(CodeAnalyzer::AnalysisMode mode)
 {
     QString currentDirPath = fileModel->rootPath();
     if (currentDirPath.isEmpty()) {
@@ -342,22 +646,66 @@ void MainWindow::analyzeCode()
         return;
     }
 
-    codeAnalyzer->analyzePaths(existingPaths);
+    repetitionModel->clear();
+    repetitionsDock->setWindowTitle("Repetitions (analyzing...)");
+    repetitionsDock->show();
+    repetitionsDock->raise();
+    analysisProgressBar->setValue(0);
+    analysisProgressBar->show();
+    cancelAnalysisButton->show();
+
+    // Runs on the analysis thread; results arrive through signals
+    codeAnalyzer->analyzePaths(existingPaths, currentDirPath, mode);
 }
 
-void MainWindow::onAnalysisFinished(const QList<CodeRepetition> &repetitions)
+void MainWindow::onAnalysisProgress(int progress)
 {
-    QString resultText;
-    if (repetitions.isEmpty()) {
-        resultText = "No significant code repetitions found in 'app' and 'resources' folders.";
-    } else {
-        resultText = QString("Found %1 code repetitions:\n\n").arg(repetitions.size());
-        for (const CodeRepetition &rep : repetitions) {
-            resultText += QString("File: %1, Lines: %2-%3\n").arg(rep.filePath).arg(rep.startLine).arg(rep.endLine);
-            resultText += "Snippet:\n" + rep.snippet + "\n\n";
+    analysisProgressBar->setValue(progress);
+}
+
+void MainWindow::onPartialResults(const RepetitionResults &results)
+{
+    repetitionModel->setResults(results, fileModel->rootPath());
+    repetitionsDock->setWindowTitle(QString("Repetitions (%1 groups so far)").arg(results.groupCount()));
+}
+
+void MainWindow::onAnalysisCancelled()
+{
+    analysisProgressBar->hide();
+    cancelAnalysisButton->hide();
+    // Whatever is listed belongs to an unfinished or earlier run
+    repetitionModel->clear();
+    repetitionsDock->setWindowTitle("Repetitions (cancelled)");
+}
+
+QString MainWindow::snippetAt(const QString &filePath, int startLine, int endLine) const
+{
+    for (int i = 0; i < tabWidget->count(); ++i) {
+        CodeEditor *editor = qobject_cast<CodeEditor*>(tabWidget->widget(i));
+        if (!editor || editor->isLoading() || editor->filePath() != filePath)
+            continue;
+        QStringList lines;
+        for (QTextBlock block = editor->document()->findBlockByNumber(startLine - 1);
+             block.isValid() && block.blockNumber() < endLine; block = block.next()) {
+            lines.append(block.text());
         }
+        return lines.join('\n').trimmed();
+    }
+    return CodeAnalyzer::snippet(filePath, startLine, endLine);
+}
+
+void MainWindow::onAnalysisFinished(const RepetitionResults &results)
+{
+    analysisProgressBar->hide();
+    cancelAnalysisButton->hide();
+    repetitionModel->setResults(results, fileModel->rootPath());
+    if (!results.similarities.isEmpty())
+        repetitionsDock->setWindowTitle(QString("Repetitions (%1 similar function pairs)").arg(results.groupCount()));
+    else
+        repetitionsDock->setWindowTitle(QString("Repetitions (%1 in %2 groups)").arg(results.repetitions.size()).arg(results.groupCount()));
+    if (results.repetitions.isEmpty()) {
+        statusBar()->showMessage("No significant code repetitions found in 'app' and 'resources' folders.", 5000);
     }
-    QMessageBox::information(this, "Code Analysis Results", resultText);
 }
 
 void MainWindow::onIndexingProgress(int progress)
@@ -371,10 +719,79 @@ void MainWindow::onIndexingFinished()
     indexingProgressBar->setValue(100);
     indexingStatusLabel->setText("Ready");
     indexingProgressBar->hide();
+    cancelIndexingButton->hide();
 
     for (int i = 0; i < tabWidget->count(); ++i) {
         if (CodeEditor *editor = qobject_cast<CodeEditor*>(tabWidget->widget(i))) {
             editor->setSymbolProvider(symbolProvider);
         }
     }
-}
\ No newline at end of file
+}
+
+void MainWindow::onIndexingCancelled()
+{
+    indexingStatusLabel->setText("Indexing cancelled");
+    indexingProgressBar->hide();
+    cancelIndexingButton->hide();
+}
+
+QString MainWindow::formatLatency(qint64 nsecs)
+{
+    if (nsecs < 1000000)
+        return QString("%1 µs").arg(nsecs / 1000);
+    return QString("%1 ms").arg(double(nsecs) / 1e6, 0, 'f', 1);
+}
+
+void MainWindow::setLatencyOverlayVisible(bool visible)
+{
+    // The overlay is the profiler's on switch; recording while hidden would
+    // only cost time
+    LatencyProfiler &profiler = LatencyProfiler::instance();
+    if (visible && !profiler.isEnabled())
+        profiler.reset();
+    profiler.setEnabled(visible);
+    latencyLabel->setVisible(visible);
+    if (visible) {
+        updateLatencyOverlay();
+        latencyTimer->start();
+    } else {
+        latencyTimer->stop();
+    }
+}
+
+void MainWindow::updateLatencyOverlay()
+{
+    const LatencyProfiler &profiler = LatencyProfiler::instance();
+    QStringList shown;
+    QStringList details;
+    for (int i = 0; i < LatencyProfiler::MetricCount; ++i) {
+        const auto metric = LatencyProfiler::Metric(i);
+        const LatencyProfiler::Summary summary = profiler.summary(metric);
+        if (summary.count == 0)
+            continue;
+        const QString percentiles = QString("%1 / %2").arg(formatLatency(summary.p50), formatLatency(summary.p99));
+        if (metric == LatencyProfiler::KeyToPaint || metric == LatencyProfiler::KeyPress
+            || metric == LatencyProfiler::HighlightBlock || metric == LatencyProfiler::ViewportPaint) {
+            shown.append(QString("%1 %2").arg(LatencyProfiler::name(metric), percentiles));
+        }
+        details.append(QString("%1: p50 / p99 %2, max %3, %4 samples")
+                           .arg(LatencyProfiler::name(metric), percentiles, formatLatency(summary.max))
+                           .arg(summary.count));
+    }
+    latencyLabel->setText(shown.isEmpty() ? "Latency: type in an editor" : "p50 / p99  " + shown.join("  |  "));
+    latencyLabel->setToolTip(details.join('\n'));
+}
+
+void MainWindow::exportLatencyTrace()
+{
+    const QString filePath = QFileDialog::getSaveFileName(this, "Export Latency Trace", "incode-latency-trace.json",
+                                                          "Chrome trace (*.json)");
+    if (filePath.isEmpty()) return;
+
+    QString errorString;
+    if (!LatencyProfiler::instance().writeChromeTrace(filePath, &errorString)) {
+        QMessageBox::warning(this, "Error", "Could not write trace: " + errorString);
+        return;
+    }
+    statusBar()->showMessage("Trace written to " + filePath + " (open it in chrome://tracing or Perfetto)", 5000);
+}
@@ -8,6 +8,8 @@
 #include <QThread>
 #include <QProgressBar>
 #include <QLabel>
+#include <QHash>
+#include <QPointer>
 
 class QTabWidget;
 class QTreeView;
@@ -15,6 +17,14 @@ class QFileSystemModel;
 // class QTextEdit; // No longer needed for editor
 class QProcess;
 class QLineEdit;
+class ProjectWatcher;
+class QListWidget;
+class QListWidgetItem;
+class QDockWidget;
+class QToolButton;
+class RepetitionModel;
+class FileLoader;
+class QTimer;
 
 class MainWindow : public QMainWindow
 {
@@ -34,14 +44,34 @@ private slots:
     void handleTerminalCommand();
     void readTerminalOutput();
     void goToDefinition(const QString &symbolName);
+    void findReferences(const QString &symbolName);
+    void onLocationActivated(QListWidgetItem *item);
+    void onRepetitionActivated(const QModelIndex &index);
     void analyzeCode();
-    void onAnalysisFinished(const QList<CodeRepetition> &repetitions);
+    void findSimilarFunctions();
+    void onAnalysisProgress(int progress);
+    void onPartialResults(const RepetitionResults &results);
+    void onAnalysisFinished(const RepetitionResults &results);
+    void onAnalysisCancelled();
     void onIndexingProgress(int progress);
     void onIndexingFinished();
+    void onIndexingCancelled();
+    void onFileChunkLoaded(int job, const QString &text);
+    void onFileLoaded(int job);
+    void onFileLoadFailed(int job, const QString &errorString);
+    void setLatencyOverlayVisible(bool visible);
+    void updateLatencyOverlay();
+    void exportLatencyTrace();
 
 protected:
     void keyPressEvent(QKeyEvent *event) override;
     void openFile(const QString &filePath);
+    void openFileAtLine(const QString &filePath, int lineNumber);
+    void connectEditor(CodeEditor *editor);
+    void runAnalysis(CodeAnalyzer::AnalysisMode mode);
+    QStringList openFilePaths() const;
+    // Lines of a file, from its editor if it is open (unsaved edits included)
+    QString snippetAt(const QString &filePath, int startLine, int endLine) const;
     void createMenus();
     void createWidgets();
     void setupLayout();
@@ -56,8 +86,26 @@ protected:
     ISymbolProvider *symbolProvider;
     CodeAnalyzer *codeAnalyzer;
     QThread *indexingThread;
+    QThread *analysisThread;
+    ProjectWatcher *projectWatcher;
     QProgressBar *indexingProgressBar;
     QLabel *indexingStatusLabel;
+    QToolButton *cancelIndexingButton;
+    QDockWidget *referencesDock;
+    QListWidget *referencesList;
+    QDockWidget *repetitionsDock;
+    QTreeView *repetitionsView;
+    RepetitionModel *repetitionModel;
+    QProgressBar *analysisProgressBar;
+    QToolButton *cancelAnalysisButton;
+    FileLoader *fileLoader;
+    QHash<int, QPointer<CodeEditor>> loadingEditors; // load job -> its tab
+    QLabel *latencyLabel;
+    QTimer *latencyTimer;
+
+private:
+    // "850 µs" or "12.3 ms"
+    static QString formatLatency(qint64 nsecs);
 };
 
 #endif // INCODE_MAINWINDOW_H
\ No newline at end of file
@@ -0,0 +1,241 @@
+#include "NearDuplicateDetector.h"
+#include <algorithm>
+#include <utility>
+
+namespace {
+
+const quint32 EmptyBin = 0xFFFFFFFFu;
+const int RowsPerBand = NearDuplicateDetector::SignatureSize / NearDuplicateDetector::Bands;
+// Members of a bucket that are paired with each other. Larger buckets (many
+// near-identical small functions) are split by signature first: copies with
+// equal signatures are paired among themselves and the distinct signatures
+// with each other, and only a group still larger than this is paired with
+// its first member alone, so no bucket adds a quadratic number of candidates
+const int MaxBucketPairs = 64;
+
+// splitmix64 finalizer
+quint64 mix(quint64 x)
+{
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ull;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebull;
+    x ^= x >> 31;
+    return x;
+}
+
+} // namespace
+
+void NearDuplicateDetector::addFile(const TokenCloneDetector::FileTokens &file)
+{
+    static const quint32 functionToken = TokenCloneDetector::textToken("function");
+    static const quint32 openBrace = TokenCloneDetector::textToken("{");
+    static const quint32 closeBrace = TokenCloneDetector::textToken("}");
+    static const quint32 semicolon = TokenCloneDetector::textToken(";");
+
+    const QVector<quint32> &tokens = file.tokens;
+    const int count = tokens.size();
+    for (int i = 0; i < count; ++i) {
+        if (tokens.at(i) != functionToken)
+            continue;
+
+        // Abstract and interface methods end at ';' before any body
+        int bodyBegin = i + 1;
+        while (bodyBegin < count && tokens.at(bodyBegin) != openBrace && tokens.at(bodyBegin) != semicolon)
+            ++bodyBegin;
+        if (bodyBegin >= count || tokens.at(bodyBegin) == semicolon) {
+            i = bodyBegin;
+            continue;
+        }
+
+        int depth = 0;
+        int bodyEnd = bodyBegin;
+        for (; bodyEnd < count; ++bodyEnd) {
+            if (tokens.at(bodyEnd) == openBrace) {
+                ++depth;
+            } else if (tokens.at(bodyEnd) == closeBrace && --depth == 0) {
+                break;
+            }
+        }
+        if (bodyEnd >= count)
+            break; // unbalanced braces, e.g. a file that is being edited
+
+        if (bodyEnd - bodyBegin - 1 >= MinFunctionTokens)
+            addFunction(file, i, bodyBegin + 1, bodyEnd);
+        // Closures inside the body belong to this function
+        i = bodyEnd;
+    }
+    ++files;
+}
+
+void NearDuplicateDetector::addFunction(const TokenCloneDetector::FileTokens &file, int start, int bodyBegin, int bodyEnd)
+{
+    // One-permutation MinHash: each shingle hash picks a bin and competes
+    // for its minimum
+    quint32 signature[SignatureSize];
+    std::fill(std::begin(signature), std::end(signature), EmptyBin);
+    const quint32 *tokens = file.tokens.constData();
+    for (int shingle = bodyBegin; shingle + ShingleLength <= bodyEnd; ++shingle) {
+        quint64 hash = 0;
+        for (int k = 0; k < ShingleLength; ++k) {
+            hash = mix(hash ^ tokens[shingle + k]);
+        }
+        const int bin = int(hash % SignatureSize);
+        const quint32 value = quint32(hash >> 32);
+        signature[bin] = std::min(signature[bin], value);
+    }
+
+    // Densification: an empty bin borrows from a filled bin chosen by a
+    // fixed per-bin sequence, so equal sets still get equal signatures
+    quint32 densified[SignatureSize];
+    for (int bin = 0; bin < SignatureSize; ++bin) {
+        densified[bin] = signature[bin];
+        for (quint64 attempt = 1; densified[bin] == EmptyBin; ++attempt) {
+            densified[bin] = signature[mix((quint64(bin) << 32) | attempt) % SignatureSize];
+        }
+    }
+
+    functionList.append(Function{files, file.lines.at(start), file.lines.at(bodyEnd), bodyEnd - bodyBegin});
+    signatures.append(QVector<quint32>(std::begin(densified), std::end(densified)));
+}
+
+void NearDuplicateDetector::clear()
+{
+    functionList = QVector<Function>();
+    signatures = QVector<quint32>();
+    files = 0;
+}
+
+float NearDuplicateDetector::similarity(int first, int second) const
+{
+    const quint32 *a = signatures.constData() + qsizetype(first) * SignatureSize;
+    const quint32 *b = signatures.constData() + qsizetype(second) * SignatureSize;
+    int equal = 0;
+    for (int bin = 0; bin < SignatureSize; ++bin) {
+        equal += a[bin] == b[bin];
+    }
+    return float(equal) / SignatureSize;
+}
+
+QVector<NearDuplicateDetector::SimilarPair> NearDuplicateDetector::detect(float minSimilarity, const Callback &callback,
+                                                                          qint64 *skippedPairs) const
+{
+    auto keepGoing = [&callback](int progress) { return !callback || callback(progress); };
+    const int count = functionList.size();
+
+    // Functions whose signatures agree on all rows of any band are candidates
+    QVector<quint64> candidates;
+    qint64 skipped = 0;
+    auto addCandidate = [&candidates](int x, int y) {
+        candidates.append((quint64(std::min(x, y)) << 32) | quint64(std::max(x, y)));
+    };
+    // Pairs all of members, or each with the first one if there are too
+    // many; returns the number of pairs among them
+    auto addGroup = [&](const QVector<int> &members) {
+        const qint64 size = members.size();
+        if (size <= MaxBucketPairs) {
+            for (int i = 0; i < size; ++i) {
+                for (int j = i + 1; j < size; ++j) {
+                    addCandidate(members.at(i), members.at(j));
+                }
+            }
+        } else {
+            for (int i = 1; i < size; ++i) {
+                addCandidate(members.at(0), members.at(i));
+            }
+            skipped += (size - 1) * (size - 2) / 2;
+        }
+        return size * (size - 1) / 2;
+    };
+    auto addOversizedBucket = [&](const std::pair<quint64, int> *bucket, int size) {
+        QVector<int> members(size);
+        for (int i = 0; i < size; ++i) {
+            members[i] = bucket[i].second;
+        }
+        auto signatureOf = [this](int function) {
+            return signatures.constData() + qsizetype(function) * SignatureSize;
+        };
+        std::sort(members.begin(), members.end(), [&signatureOf](int x, int y) {
+            const quint32 *a = signatureOf(x);
+            const quint32 *b = signatureOf(y);
+            return std::lexicographical_compare(a, a + SignatureSize, b, b + SignatureSize)
+                || (x < y && std::equal(a, a + SignatureSize, b));
+        });
+
+        // Copies with equal signatures are paired among themselves, the
+        // first of each with the other distinct signatures
+        QVector<int> distinct;
+        qint64 covered = 0;
+        for (int begin = 0; begin < size;) {
+            int end = begin + 1;
+            while (end < size && std::equal(signatureOf(members.at(begin)), signatureOf(members.at(begin)) + SignatureSize,
+                                            signatureOf(members.at(end))))
+                ++end;
+            covered += addGroup(members.mid(begin, end - begin));
+            distinct.append(members.at(begin));
+            begin = end;
+        }
+        covered += addGroup(distinct);
+        // What is left are pairs across copies that aren't the first of
+        // their signature; their similarity is that of the first ones
+        skipped += qint64(size) * (size - 1) / 2 - covered;
+    };
+    QVector<std::pair<quint64, int>> buckets(count);
+    for (int band = 0; band < Bands; ++band) {
+        for (int function = 0; function < count; ++function) {
+            const quint32 *rows = signatures.constData() + qsizetype(function) * SignatureSize + band * RowsPerBand;
+            quint64 key = quint64(band);
+            for (int row = 0; row < RowsPerBand; ++row) {
+                key = mix(key ^ rows[row]);
+            }
+            buckets[function] = {key, function};
+        }
+        std::sort(buckets.begin(), buckets.end());
+
+        for (int begin = 0; begin < count;) {
+            int end = begin + 1;
+            while (end < count && buckets.at(end).first == buckets.at(begin).first)
+                ++end;
+            if (end - begin <= MaxBucketPairs) {
+                for (int i = begin; i < end; ++i) {
+                    for (int j = i + 1; j < end; ++j) {
+                        addCandidate(buckets.at(i).second, buckets.at(j).second);
+                    }
+                }
+            } else {
+                addOversizedBucket(buckets.constData() + begin, end - begin);
+            }
+            begin = end;
+        }
+        if (!keepGoing(((band + 1) * 70) / Bands))
+            return QVector<SimilarPair>();
+    }
+    if (skippedPairs)
+        *skippedPairs = skipped;
+    std::sort(candidates.begin(), candidates.end());
+    candidates.erase(std::unique(candidates.begin(), candidates.end()), candidates.end());
+
+    QVector<SimilarPair> pairs;
+    for (int i = 0; i < candidates.size(); ++i) {
+        const int first = int(candidates.at(i) >> 32);
+        const int second = int(candidates.at(i) & 0xFFFFFFFFu);
+        const float estimate = similarity(first, second);
+        if (estimate >= minSimilarity)
+            pairs.append(SimilarPair{first, second, estimate});
+        if (i % 65536 == 0 && !keepGoing(70 + int((qint64(i) * 25) / candidates.size())))
+            return QVector<SimilarPair>();
+    }
+
+    // Most similar first; among equals the larger functions matter more
+    std::sort(pairs.begin(), pairs.end(), [this](const SimilarPair &x, const SimilarPair &y) {
+        if (x.similarity != y.similarity)
+            return x.similarity > y.similarity;
+        const int xTokens = functionList.at(x.first).tokenCount + functionList.at(x.second).tokenCount;
+        const int yTokens = functionList.at(y.first).tokenCount + functionList.at(y.second).tokenCount;
+        if (xTokens != yTokens)
+            return xTokens > yTokens;
+        return std::make_pair(x.first, x.second) < std::make_pair(y.first, y.second);
+    });
+    keepGoing(100);
+    return pairs;
+}
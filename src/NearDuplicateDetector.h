@@ -0,0 +1,69 @@
+#ifndef INCODE_NEARDUPLICATEDETECTOR_H
+#define INCODE_NEARDUPLICATEDETECTOR_H
+
+#include "TokenCloneDetector.h"
+#include <QVector>
+#include <functional>
+
+// Finds pairs of similar functions: copies that had statements added,
+// removed or changed (Type-3 clones), which TokenCloneDetector only sees as
+// shorter fragments.
+//
+// Each function body is reduced to the set of its ShingleLength-grams of
+// normalized tokens and summarized by a MinHash signature (one-permutation
+// hashing with densification, so one hash per shingle). Locality-sensitive
+// hashing over Bands bands of the signature yields candidate pairs without
+// comparing every pair, and candidates are ranked by the Jaccard similarity
+// their signatures estimate.
+class NearDuplicateDetector
+{
+public:
+    struct Function {
+        int fileIndex;
+        int startLine;
+        int endLine;
+        int tokenCount; // of the body
+    };
+
+    struct SimilarPair {
+        int first;        // indices into functions()
+        int second;
+        float similarity; // estimated Jaccard similarity, 0-1
+    };
+
+    // Called with the progress of detect() (0-100); returning false stops it
+    using Callback = std::function<bool(int progress)>;
+
+    static constexpr int ShingleLength = 5;
+    static constexpr int SignatureSize = 128;
+    // Bands of SignatureSize / Bands rows each. Pairs at 85% similarity
+    // become candidates with a probability of over 99%, pairs at 50% with
+    // about 6%.
+    static constexpr int Bands = 16;
+    // Shorter bodies (getters, one-line delegations) are all alike
+    static constexpr int MinFunctionTokens = 40;
+
+    // Extracts the functions of the next file and keeps their signatures;
+    // the tokens themselves aren't needed afterwards
+    void addFile(const TokenCloneDetector::FileTokens &file);
+    void clear();
+
+    int fileCount() const { return files; }
+    const QVector<Function> &functions() const { return functionList; }
+
+    // Pairs of at least minSimilarity, most similar first. skippedPairs
+    // receives how many pairs of oversized LSH buckets were not compared;
+    // another band may still have made them candidates.
+    QVector<SimilarPair> detect(float minSimilarity, const Callback &callback = Callback(),
+                                qint64 *skippedPairs = nullptr) const;
+
+private:
+    void addFunction(const TokenCloneDetector::FileTokens &file, int start, int bodyBegin, int bodyEnd);
+    float similarity(int first, int second) const;
+
+    QVector<Function> functionList;
+    QVector<quint32> signatures; // SignatureSize values per function
+    int files = 0;
+};
+
+#endif // INCODE_NEARDUPLICATEDETECTOR_H
@@ -0,0 +1,308 @@
+#include "PhpHighlightLexer.h"
+#include <cstring>
+
+namespace {
+
+constexpr const char *Keywords[] = {
+    "abstract", "and", "array", "as", "break", "callable", "case", "catch", "class", "clone",
+    "const", "continue", "declare", "default", "die", "do", "echo", "else", "elseif", "empty",
+    "enddeclare", "endfor", "endforeach", "endif", "endswitch", "endwhile", "enum", "eval", "exit",
+    "extends", "false", "final", "finally", "fn", "for", "foreach", "function", "global", "goto",
+    "if", "implements", "include", "include_once", "instanceof", "insteadof", "interface", "isset",
+    "list", "match", "namespace", "new", "null", "or", "parent", "print", "private", "protected",
+    "public", "readonly", "require", "require_once", "return", "self", "static", "switch", "throw",
+    "trait", "true", "try", "unset", "use", "var", "while", "xor", "yield"
+};
+constexpr int MaxKeywordLength = 12;
+constexpr int KeywordSlots = 256;
+// Found by search so that no two keywords share a slot; the static_assert
+// below catches a keyword list that no longer fits it
+constexpr quint32 KeywordSeed = 307979;
+
+// FNV-1a from KeywordSeed, top byte
+constexpr int keywordSlot(const char *word, int length)
+{
+    quint32 hash = KeywordSeed;
+    for (int i = 0; i < length; ++i) {
+        hash = (hash ^ quint8(word[i])) * 16777619u;
+    }
+    return int(hash >> 24);
+}
+
+constexpr int lengthOf(const char *text)
+{
+    int length = 0;
+    while (text[length])
+        ++length;
+    return length;
+}
+
+struct KeywordTable {
+    const char *slots[KeywordSlots] = {};
+    quint8 lengths[KeywordSlots] = {};
+    bool perfect = true;
+};
+
+constexpr KeywordTable makeKeywordTable()
+{
+    KeywordTable table;
+    for (const char *keyword : Keywords) {
+        const int length = lengthOf(keyword);
+        const int slot = keywordSlot(keyword, length);
+        if (table.slots[slot] || length > MaxKeywordLength)
+            table.perfect = false;
+        table.slots[slot] = keyword;
+        table.lengths[slot] = quint8(length);
+    }
+    return table;
+}
+
+constexpr KeywordTable KeywordLookup = makeKeywordTable();
+static_assert(KeywordLookup.perfect, "keyword hash has collisions; search for another KeywordSeed");
+
+inline bool isNameStart(ushort c)
+{
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_' || c >= 0x80;
+}
+
+inline bool isNameChar(ushort c)
+{
+    return isNameStart(c) || (c >= '0' && c <= '9');
+}
+
+inline bool isBlank(ushort c)
+{
+    return c == ' ' || c == '\t';
+}
+
+// Index of the quote that closes a string, skipping backslash escapes, or -1
+int closingQuote(const QChar *text, int from, int length, ushort quote)
+{
+    for (int pos = from; pos < length; ++pos) {
+        const ushort c = text[pos].unicode();
+        if (c == '\\')
+            ++pos;
+        else if (c == quote)
+            return pos;
+    }
+    return -1;
+}
+
+int blockCommentEnd(const QChar *text, int from, int length)
+{
+    for (int pos = from; pos + 1 < length; ++pos) {
+        if (text[pos].unicode() == '*' && text[pos + 1].unicode() == '/')
+            return pos;
+    }
+    return -1;
+}
+
+} // namespace
+
+bool PhpHighlightLexer::isKeyword(const QChar *word, int length)
+{
+    if (length > MaxKeywordLength)
+        return false;
+    char lower[MaxKeywordLength];
+    for (int i = 0; i < length; ++i) {
+        ushort c = word[i].unicode();
+        if (c >= 'A' && c <= 'Z')
+            c = ushort(c - 'A' + 'a');
+        else if (c >= 0x80)
+            return false;
+        lower[i] = char(c);
+    }
+    const int slot = keywordSlot(lower, length);
+    return KeywordLookup.lengths[slot] == length && std::memcmp(KeywordLookup.slots[slot], lower, size_t(length)) == 0;
+}
+
+int PhpHighlightLexer::labelState(Mode mode, const QString &label)
+{
+    int index = labels.indexOf(label);
+    if (index < 0) {
+        index = labels.size();
+        labels.append(label);
+    }
+    return mode | (index << ModeBits);
+}
+
+int PhpHighlightLexer::highlightLine(const QChar *text, int length, int state, QVector<Span> &spans)
+{
+    spans.clear();
+    auto add = [&spans](int start, int end, Category category) {
+        if (end > start)
+            spans.append(Span{start, end - start, category});
+    };
+
+    // First finish what the previous line left open
+    int pos = 0;
+    switch (Mode(state & ModeMask)) {
+    case Code:
+        break;
+    case BlockComment: {
+        const int end = blockCommentEnd(text, 0, length);
+        if (end < 0) {
+            add(0, length, Comment);
+            return state;
+        }
+        pos = end + 2;
+        add(0, pos, Comment);
+        break;
+    }
+    case SingleQuoted:
+    case DoubleQuoted: {
+        const int end = closingQuote(text, 0, length, (state & ModeMask) == SingleQuoted ? '\'' : '"');
+        if (end < 0) {
+            add(0, length, String);
+            return state;
+        }
+        pos = end + 1;
+        add(0, pos, String);
+        break;
+    }
+    case Heredoc:
+    case Nowdoc: {
+        // The closing label may be indented and followed by ';', ',' or ')'
+        const QString &label = labels.at(state >> ModeBits);
+        int start = 0;
+        while (start < length && isBlank(text[start].unicode()))
+            ++start;
+        const int end = start + int(label.size());
+        if (end > length || QStringView(text + start, label.size()) != label
+            || (end < length && isNameChar(text[end].unicode()))) {
+            add(0, length, String);
+            return state;
+        }
+        pos = end;
+        add(0, pos, String);
+        break;
+    }
+    }
+
+    // A name after -> or :: is a member, never a keyword or class
+    bool afterMemberAccess = false;
+    while (pos < length) {
+        const ushort c = text[pos].unicode();
+        const ushort next = pos + 1 < length ? text[pos + 1].unicode() : 0;
+
+        if (isNameStart(c)) {
+            const int start = pos;
+            while (pos < length && isNameChar(text[pos].unicode()))
+                ++pos;
+            const bool isCall = pos < length && text[pos].unicode() == '(';
+            if (!afterMemberAccess && isKeyword(text + start, pos - start))
+                add(start, pos, Keyword);
+            else if (isCall)
+                add(start, pos, Function);
+            else if (!afterMemberAccess && c >= 'A' && c <= 'Z' && pos - start > 1)
+                add(start, pos, ClassName);
+            afterMemberAccess = false;
+            continue;
+        }
+
+        switch (c) {
+        case ' ':
+        case '\t':
+            ++pos;
+            continue;
+        case '$':
+            // Variables are left plain, but $class must not read as a keyword
+            for (++pos; pos < length && isNameChar(text[pos].unicode()); ++pos) {
+            }
+            break;
+        case '#':
+            if (next == '[') { // attribute
+                pos += 2;
+                break;
+            }
+            add(pos, length, Comment);
+            return Code;
+        case '/':
+            if (next == '/') {
+                add(pos, length, Comment);
+                return Code;
+            }
+            if (next == '*') {
+                const int end = blockCommentEnd(text, pos + 2, length);
+                if (end < 0) {
+                    add(pos, length, Comment);
+                    return BlockComment;
+                }
+                add(pos, end + 2, Comment);
+                pos = end + 2;
+                break;
+            }
+            ++pos;
+            break;
+        case '\'':
+        case '"': {
+            const int end = closingQuote(text, pos + 1, length, c);
+            if (end < 0) {
+                add(pos, length, String);
+                return c == '\'' ? SingleQuoted : DoubleQuoted;
+            }
+            add(pos, end + 1, String);
+            pos = end + 1;
+            break;
+        }
+        case '<': {
+            // <<<LABEL, <<<"LABEL" or <<<'LABEL' (nowdoc), alone at the end of the line
+            if (next != '<' || pos + 2 >= length || text[pos + 2].unicode() != '<') {
+                ++pos;
+                break;
+            }
+            int labelStart = pos + 3;
+            while (labelStart < length && isBlank(text[labelStart].unicode()))
+                ++labelStart;
+            const ushort quote = labelStart < length ? text[labelStart].unicode() : 0;
+            const bool quoted = quote == '\'' || quote == '"';
+            if (quoted)
+                ++labelStart;
+            int labelEnd = labelStart;
+            while (labelEnd < length && isNameChar(text[labelEnd].unicode()))
+                ++labelEnd;
+            const int afterLabel = labelEnd + (quoted ? 1 : 0);
+            if (labelEnd == labelStart || !isNameStart(text[labelStart].unicode())
+                || (quoted && (labelEnd >= length || text[labelEnd].unicode() != quote)) || afterLabel != length) {
+                pos += 3;
+                break;
+            }
+            add(pos, length, String);
+            return labelState(quote == '\'' ? Nowdoc : Heredoc, QString(text + labelStart, labelEnd - labelStart));
+        }
+        case '-':
+            if (next == '>') {
+                pos += 2;
+                afterMemberAccess = true;
+                continue;
+            }
+            ++pos;
+            break;
+        case ':':
+            if (next == ':') {
+                pos += 2;
+                afterMemberAccess = true;
+                continue;
+            }
+            ++pos;
+            break;
+        case '?':
+            // ?-> keeps the member access pending
+            ++pos;
+            if (next == '-')
+                continue;
+            break;
+        default:
+            if (c >= '0' && c <= '9') {
+                // Numbers, including 0x1F and 1_000, are plain
+                while (pos < length && isNameChar(text[pos].unicode()))
+                    ++pos;
+            } else {
+                ++pos;
+            }
+            break;
+        }
+        afterMemberAccess = false;
+    }
+    return Code;
+}
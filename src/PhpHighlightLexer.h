@@ -0,0 +1,67 @@
+#ifndef INCODE_PHPHIGHLIGHTLEXER_H
+#define INCODE_PHPHIGHLIGHTLEXER_H
+
+#include <QChar>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+
+// Splits PHP source into highlighted spans one line at a time, the way
+// QSyntaxHighlighter asks for them. Each line is lexed in a single pass
+// that starts in the state the previous line ended in; the state, a plain
+// int, carries block comments, quoted strings that continue on the next
+// line and heredoc/nowdoc bodies. Keywords are looked up in a perfect hash
+// table built at compile time.
+class PhpHighlightLexer
+{
+public:
+    enum Category : quint8 {
+        Keyword,
+        ClassName,
+        Function,
+        String,
+        Comment,
+        CategoryCount
+    };
+
+    struct Span {
+        int start;
+        int length;
+        Category category;
+    };
+
+    // State before the first line
+    static constexpr int InitialState = 0;
+
+    // Lexes one line, without its line break, into spans (which are
+    // cleared first). Returns the state the next line starts in.
+    int highlightLine(const QChar *text, int length, int state, QVector<Span> &spans);
+    int highlightLine(const QString &line, int state, QVector<Span> &spans)
+    {
+        return highlightLine(line.constData(), int(line.size()), state, spans);
+    }
+
+    // Whether a word is a PHP keyword, case-insensitively
+    static bool isKeyword(const QChar *word, int length);
+
+private:
+    // Low bits of a state; heredoc and nowdoc states keep the index of their
+    // closing label in the bits above
+    enum Mode {
+        Code,
+        BlockComment,
+        SingleQuoted,
+        DoubleQuoted,
+        Heredoc,
+        Nowdoc
+    };
+    static constexpr int ModeBits = 3;
+    static constexpr int ModeMask = (1 << ModeBits) - 1;
+
+    int labelState(Mode mode, const QString &label);
+
+    // Closing labels seen so far, referenced from states by index
+    QStringList labels;
+};
+
+#endif // INCODE_PHPHIGHLIGHTLEXER_H
@@ -0,0 +1,478 @@
+#include "PhpSymbolLexer.h"
+#include "Varint.h"
+#include <QString>
+#include <algorithm>
+#include <cstring>
+
+namespace {
+
+inline bool isIdentifierStart(uchar c)
+{
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_' || c >= 0x80;
+}
+
+inline bool isIdentifierChar(uchar c)
+{
+    return isIdentifierStart(c) || (c >= '0' && c <= '9');
+}
+
+// PHP keywords are case-insensitive; keyword must be lower case
+bool isKeyword(const char *word, int length, const char *keyword)
+{
+    for (int i = 0; i < length; ++i) {
+        char c = word[i];
+        if (c >= 'A' && c <= 'Z')
+            c = char(c - 'A' + 'a');
+        if (keyword[i] != c)
+            return false;
+    }
+    return keyword[length] == '\0';
+}
+
+// Keywords and built-in type names: never worth recording as references
+const char *const ReservedWords[] = {
+    "abstract", "and", "array", "as", "bool", "break", "callable", "case", "catch", "class",
+    "clone", "const", "continue", "declare", "default", "do", "echo", "else", "elseif", "empty",
+    "enddeclare", "endfor", "endforeach", "endif", "endswitch", "endwhile", "enum", "extends",
+    "false", "final", "finally", "float", "fn", "for", "foreach", "function", "global", "goto",
+    "if", "implements", "include", "include_once", "instanceof", "insteadof", "int", "interface",
+    "isset", "iterable", "list", "match", "mixed", "namespace", "never", "new", "null", "object",
+    "or", "parent", "print", "private", "protected", "public", "readonly", "require",
+    "require_once", "return", "self", "static", "string", "switch", "throw", "trait", "true",
+    "try", "unset", "use", "var", "void", "while", "xor", "yield"
+};
+
+// Case-insensitive ordering of word against a lower-case keyword
+int compareKeyword(const char *word, int length, const char *keyword)
+{
+    for (int i = 0; i < length; ++i) {
+        char c = word[i];
+        if (c >= 'A' && c <= 'Z')
+            c = char(c - 'A' + 'a');
+        if (keyword[i] == '\0' || c > keyword[i])
+            return 1;
+        if (c < keyword[i])
+            return -1;
+    }
+    return keyword[length] == '\0' ? 0 : -1;
+}
+
+bool isReservedWord(const char *word, int length)
+{
+    if (length > 12)
+        return false;
+    int low = 0;
+    int high = int(sizeof(ReservedWords) / sizeof(ReservedWords[0]));
+    while (low < high) {
+        const int middle = (low + high) / 2;
+        const int order = compareKeyword(word, length, ReservedWords[middle]);
+        if (order == 0)
+            return true;
+        if (order > 0)
+            low = middle + 1;
+        else
+            high = middle;
+    }
+    return false;
+}
+
+int compareBytes(const char *a, int aLength, const char *b, int bLength)
+{
+    const int common = qMin(aLength, bLength);
+    const int result = common > 0 ? std::memcmp(a, b, size_t(common)) : 0;
+    return result != 0 ? result : aLength - bLength;
+}
+
+} // namespace
+
+PhpSymbolLexer::PhpSymbolLexer(const QByteArray &source)
+    : source(source), pos(this->source.constData()), end(this->source.constData() + this->source.size())
+{
+}
+
+void PhpSymbolLexer::run()
+{
+    while (pos < end && !halted) {
+        if (inHtml) {
+            skipInlineHtml();
+            continue;
+        }
+
+        const char c = *pos;
+        if (c == '\n') {
+            ++line;
+            ++pos;
+        } else if (c == ' ' || c == '\t' || c == '\r' || c == '\f' || c == '\v') {
+            ++pos;
+        } else if (c == '#' && pos + 1 < end && pos[1] == '[') {
+            // PHP 8 attribute: its contents are ordinary tokens
+            pos += 2;
+            handlePunctuation('[');
+        } else if (c == '#' || (c == '/' && pos + 1 < end && pos[1] == '/')) {
+            skipLineComment();
+        } else if (c == '/' && pos + 1 < end && pos[1] == '*') {
+            skipBlockComment();
+        } else if (c == '\'' || c == '"' || c == '`') {
+            skipQuoted(c);
+            previous = Previous::Other;
+        } else if (c == '<' && end - pos >= 3 && pos[1] == '<' && pos[2] == '<' && skipHeredoc()) {
+            previous = Previous::Other;
+        } else if (c == '?' && pos + 1 < end && pos[1] == '>') {
+            // Closing tag: also ends the current statement
+            pos += 2;
+            inHtml = true;
+            handlePunctuation(';');
+        } else if ((c == '-' && pos + 1 < end && pos[1] == '>')
+                   || (c == ':' && pos + 1 < end && pos[1] == ':')) {
+            pos += 2;
+            previous = Previous::MemberAccess;
+        } else if (c == '?' && end - pos >= 3 && pos[1] == '-' && pos[2] == '>') {
+            pos += 3;
+            previous = Previous::MemberAccess;
+        } else if (c == '$') {
+            // Variables are never declarations, whatever they are called
+            ++pos;
+            while (pos < end && isIdentifierChar(uchar(*pos)))
+                ++pos;
+            previous = Previous::Other;
+        } else if (c >= '0' && c <= '9') {
+            while (pos < end && isIdentifierChar(uchar(*pos)))
+                ++pos;
+            previous = Previous::Other;
+        } else if (isIdentifierStart(uchar(c))) {
+            const char *start = pos;
+            while (pos < end && isIdentifierChar(uchar(*pos)))
+                ++pos;
+            handleIdentifier(start, int(pos - start));
+        } else {
+            ++pos;
+            handlePunctuation(c);
+        }
+    }
+}
+
+void PhpSymbolLexer::encodeReferences(QByteArray &names, QByteArray &lines) const
+{
+    names.clear();
+    lines.clear();
+
+    // Group by name; the stable sort keeps each name's lines ascending
+    QVector<Occurrence> sorted = occurrences;
+    std::stable_sort(sorted.begin(), sorted.end(), [](const Occurrence &a, const Occurrence &b) {
+        return compareBytes(a.start, a.length, b.start, b.length) < 0;
+    });
+
+    for (int i = 0; i < sorted.size();) {
+        const Occurrence &first = sorted.at(i);
+        int next = i + 1;
+        int distinctLines = 1;
+        while (next < sorted.size()
+               && compareBytes(first.start, first.length, sorted.at(next).start, sorted.at(next).length) == 0) {
+            if (sorted.at(next).line != sorted.at(next - 1).line)
+                ++distinctLines;
+            ++next;
+        }
+
+        names.append(first.start, first.length);
+        names.append('\0');
+        appendVarint(lines, quint32(distinctLines));
+        int lastLine = 0;
+        for (int j = i; j < next; ++j) {
+            const int line = sorted.at(j).line;
+            if (line != lastLine) {
+                appendVarint(lines, quint32(line - lastLine));
+                lastLine = line;
+            }
+        }
+        i = next;
+    }
+}
+
+void PhpSymbolLexer::skipInlineHtml()
+{
+    while (pos < end) {
+        if (*pos == '\n') {
+            ++line;
+        } else if (*pos == '<' && end - pos >= 3 && pos[1] == '?') {
+            if (pos[2] == '=') {
+                pos += 3;
+                inHtml = false;
+                return;
+            }
+            if (end - pos >= 5 && isKeyword(pos + 2, 3, "php")) {
+                pos += 5;
+                inHtml = false;
+                return;
+            }
+        }
+        ++pos;
+    }
+}
+
+void PhpSymbolLexer::skipLineComment()
+{
+    // A line comment ends at the newline or at a closing tag
+    while (pos < end && *pos != '\n') {
+        if (*pos == '?' && pos + 1 < end && pos[1] == '>')
+            return;
+        ++pos;
+    }
+}
+
+void PhpSymbolLexer::skipBlockComment()
+{
+    pos += 2;
+    while (pos < end) {
+        if (*pos == '*' && pos + 1 < end && pos[1] == '/') {
+            pos += 2;
+            return;
+        }
+        if (*pos == '\n')
+            ++line;
+        ++pos;
+    }
+}
+
+void PhpSymbolLexer::skipQuoted(char quote)
+{
+    ++pos;
+    while (pos < end) {
+        const char c = *pos++;
+        if (c == quote)
+            return;
+        if (c == '\n') {
+            ++line;
+        } else if (c == '\\' && pos < end) {
+            if (*pos == '\n')
+                ++line;
+            ++pos;
+        }
+    }
+}
+
+bool PhpSymbolLexer::skipHeredoc()
+{
+    // <<<LABEL, <<<"LABEL" (heredoc) or <<<'LABEL' (nowdoc), then a newline
+    const char *p = pos + 3;
+    while (p < end && (*p == ' ' || *p == '\t'))
+        ++p;
+    char quote = 0;
+    if (p < end && (*p == '"' || *p == '\'')) {
+        quote = *p;
+        ++p;
+    }
+    const char *label = p;
+    while (p < end && isIdentifierChar(uchar(*p)))
+        ++p;
+    const int labelLength = int(p - label);
+    if (labelLength == 0 || !isIdentifierStart(uchar(*label)))
+        return false;
+    if (quote) {
+        if (p >= end || *p != quote)
+            return false;
+        ++p;
+    }
+    if (p < end && *p == '\r')
+        ++p;
+    if (p >= end || *p != '\n')
+        return false;
+
+    // The body ends at the first line that starts (after optional indentation)
+    // with the label not followed by an identifier character
+    pos = p;
+    while (pos < end) {
+        ++line; // the newline at pos
+        ++pos;
+        const char *lineStart = pos;
+        while (lineStart < end && (*lineStart == ' ' || *lineStart == '\t'))
+            ++lineStart;
+        if (end - lineStart >= labelLength && qstrncmp(lineStart, label, size_t(labelLength)) == 0
+            && (lineStart + labelLength == end || !isIdentifierChar(uchar(lineStart[labelLength])))) {
+            pos = lineStart + labelLength;
+            return true;
+        }
+        while (pos < end && *pos != '\n')
+            ++pos;
+    }
+    return true;
+}
+
+void PhpSymbolLexer::handleIdentifier(const char *start, int length)
+{
+    const Previous before = previous;
+    previous = Previous::Other;
+
+    // Member names may be keywords (->list(), ::match), but ::class isn't a use
+    if (before == Previous::MemberAccess ? !isKeyword(start, length, "class") : !isReservedWord(start, length))
+        occurrences.append(Occurrence{start, length, line});
+
+    // ->name, ?->name, ::name (including ::class) are member references
+    if (before == Previous::MemberAccess)
+        return;
+
+    switch (expect) {
+    case Expect::ClassLikeName:
+        expect = Expect::Nothing;
+        if (pendingKind == SymbolKind::Class
+            && (isKeyword(start, length, "extends") || isKeyword(start, length, "implements")))
+            return;
+        record(start, length, pendingKind, line);
+        return;
+    case Expect::FunctionName: {
+        expect = Expect::Nothing;
+        const bool isMethod = !classBodies.isEmpty() && classBodies.last() == depth;
+        record(start, length, isMethod ? SymbolKind::Method : SymbolKind::Function, line);
+        return;
+    }
+    case Expect::ConstName:
+        // Typed constants ("const string NAME") name the last identifier before '='
+        constName = start;
+        constNameLength = length;
+        constNameLine = line;
+        return;
+    case Expect::ConstValue:
+        return;
+    case Expect::Nothing:
+        break;
+    }
+
+    if (isKeyword(start, length, "class")) {
+        // "new class" is an anonymous class: its body still holds methods
+        pendingBody = true;
+        pendingKind = SymbolKind::Class;
+        if (before != Previous::New)
+            expect = Expect::ClassLikeName;
+    } else if (isKeyword(start, length, "interface")) {
+        pendingBody = true;
+        pendingKind = SymbolKind::Interface;
+        expect = Expect::ClassLikeName;
+    } else if (isKeyword(start, length, "trait")) {
+        pendingBody = true;
+        pendingKind = SymbolKind::Trait;
+        expect = Expect::ClassLikeName;
+    } else if (isKeyword(start, length, "enum")) {
+        // "enum" is only a keyword when a name follows it
+        if (nextIsDeclarationName()) {
+            pendingBody = true;
+            pendingKind = SymbolKind::Enum;
+            expect = Expect::ClassLikeName;
+        }
+    } else if (isKeyword(start, length, "function")) {
+        // "use function Foo\bar;" imports, it doesn't declare
+        if (before != Previous::Use)
+            expect = Expect::FunctionName;
+    } else if (isKeyword(start, length, "const")) {
+        if (before != Previous::Use) {
+            expect = Expect::ConstName;
+            constName = nullptr;
+        }
+    } else if (isKeyword(start, length, "define")) {
+        readDefine();
+    } else if (isKeyword(start, length, "new")) {
+        previous = Previous::New;
+    } else if (isKeyword(start, length, "use")) {
+        previous = Previous::Use;
+    } else if (isKeyword(start, length, "__halt_compiler")) {
+        halted = true;
+    }
+}
+
+void PhpSymbolLexer::handlePunctuation(char c)
+{
+    previous = Previous::Other;
+
+    switch (c) {
+    case '{':
+        ++depth;
+        if (pendingBody) {
+            classBodies.append(depth);
+            pendingBody = false;
+        }
+        if (expect == Expect::ConstValue)
+            ++constNesting;
+        else
+            expect = Expect::Nothing;
+        break;
+    case '}':
+        if (!classBodies.isEmpty() && classBodies.last() == depth)
+            classBodies.removeLast();
+        if (depth > 0)
+            --depth;
+        if (expect == Expect::ConstValue)
+            --constNesting;
+        break;
+    case '(':
+    case '[':
+        if (expect == Expect::ConstValue)
+            ++constNesting;
+        else if (expect == Expect::FunctionName || expect == Expect::ClassLikeName)
+            expect = Expect::Nothing; // closure or anonymous class arguments
+        break;
+    case ')':
+    case ']':
+        if (expect == Expect::ConstValue)
+            --constNesting;
+        break;
+    case '=':
+        if (expect == Expect::ConstName && constName) {
+            record(constName, constNameLength, SymbolKind::Constant, constNameLine);
+            expect = Expect::ConstValue;
+            constNesting = 0;
+        }
+        break;
+    case ',':
+        if (expect == Expect::ConstValue && constNesting <= 0) {
+            expect = Expect::ConstName;
+            constName = nullptr;
+        }
+        break;
+    case ';':
+        expect = Expect::Nothing;
+        pendingBody = false;
+        break;
+    default:
+        break;
+    }
+}
+
+bool PhpSymbolLexer::nextIsDeclarationName() const
+{
+    const char *p = pos;
+    while (p < end && (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n'))
+        ++p;
+    if (p >= end || !isIdentifierStart(uchar(*p)))
+        return false;
+    const char *start = p;
+    while (p < end && isIdentifierChar(uchar(*p)))
+        ++p;
+    const int length = int(p - start);
+    return !isKeyword(start, length, "extends") && !isKeyword(start, length, "implements");
+}
+
+void PhpSymbolLexer::readDefine()
+{
+    // define('NAME', value) declares a global constant
+    const char *p = pos;
+    int lines = 0;
+    while (p < end && (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n'))
+        lines += (*p++ == '\n');
+    if (p >= end || *p != '(')
+        return;
+    ++p;
+    while (p < end && (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n'))
+        lines += (*p++ == '\n');
+    if (p >= end || (*p != '\'' && *p != '"'))
+        return;
+
+    const char quote = *p++;
+    const char *name = p;
+    while (p < end && isIdentifierChar(uchar(*p)))
+        ++p;
+    if (p < end && *p == quote && p > name)
+        record(name, int(p - name), SymbolKind::Constant, line + lines);
+}
+
+void PhpSymbolLexer::record(const char *name, int length, SymbolKind kind, int lineNumber)
+{
+    found.append(IndexedSymbol{QString::fromUtf8(name, length), lineNumber, kind});
+}
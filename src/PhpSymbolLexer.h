@@ -0,0 +1,87 @@
+#ifndef INCODE_PHPSYMBOLLEXER_H
+#define INCODE_PHPSYMBOLLEXER_H
+
+#include "SymbolIndexCache.h"
+#include <QByteArray>
+#include <QList>
+#include <QVector>
+
+// Extracts declarations (classes, interfaces, traits, enums, functions,
+// methods and constants) from PHP source in a single pass over the raw UTF-8
+// bytes. Inline HTML, strings, comments and heredoc/nowdoc bodies are skipped,
+// so nothing inside them is mistaken for a declaration. The same pass also
+// collects every identifier occurrence for Find References.
+class PhpSymbolLexer
+{
+public:
+    explicit PhpSymbolLexer(const QByteArray &source);
+
+    // Lexes the whole source; call once before the accessors below
+    void run();
+
+    QList<IndexedSymbol> symbols() const { return found; }
+
+    // Identifier occurrences (declarations and uses, but not keywords or
+    // variables) in the compact form stored in IndexedFile: the distinct
+    // names, '\0'-terminated, and for each name a varint line count followed
+    // by varint deltas of its distinct line numbers.
+    void encodeReferences(QByteArray &names, QByteArray &lines) const;
+
+private:
+    struct Occurrence {
+        const char *start;
+        int length;
+        int line;
+    };
+
+    // What the next identifier (or '=') means in the current declaration
+    enum class Expect {
+        Nothing,
+        ClassLikeName,
+        FunctionName,
+        ConstName,
+        ConstValue
+    };
+
+    // The previous significant token, where it changes how an identifier reads
+    enum class Previous {
+        Other,
+        MemberAccess, // ->, ?-> or ::
+        New,
+        Use
+    };
+
+    void skipInlineHtml();
+    void skipLineComment();
+    void skipBlockComment();
+    void skipQuoted(char quote);
+    bool skipHeredoc();
+    void handleIdentifier(const char *start, int length);
+    void handlePunctuation(char c);
+    bool nextIsDeclarationName() const;
+    void readDefine();
+    void record(const char *name, int length, SymbolKind kind, int lineNumber);
+
+    const QByteArray source;
+    const char *pos;
+    const char *end;
+    int line = 1;
+    int depth = 0;
+    bool inHtml = true;
+    bool halted = false;
+
+    Expect expect = Expect::Nothing;
+    Previous previous = Previous::Other;
+    SymbolKind pendingKind = SymbolKind::Class;
+    bool pendingBody = false;
+    QVector<int> classBodies; // brace depth of each open class-like body
+    int constNesting = 0;
+    const char *constName = nullptr;
+    int constNameLength = 0;
+    int constNameLine = 0;
+
+    QList<IndexedSymbol> found;
+    QVector<Occurrence> occurrences;
+};
+
+#endif // INCODE_PHPSYMBOLLEXER_H
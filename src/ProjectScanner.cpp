@@ -0,0 +1,166 @@
+#include "ProjectScanner.h"
+#include <QAtomicInt>
+#include <QDateTime>
+#include <QDir>
+#include <QDirIterator>
+#include <QFile>
+#include <QFileInfo>
+#include <QThreadPool>
+#include <QDebug>
+
+ProjectScanner::ProjectScanner(QThreadPool *pool) : pool(pool)
+{
+}
+
+QVector<ScannedFile> ProjectScanner::walk(const QStringList &roots, const IgnoreRules &ignoreRules,
+                                          const CancelCheck &cancelled, WalkStats *stats)
+{
+    // Nested .gitignore files are added as they are found
+    IgnoreRules rules = ignoreRules;
+    WalkStats counts;
+    QVector<ScannedFile> files;
+
+    for (const QString &root : roots) {
+        const QString start = QDir::cleanPath(root);
+        if (rules.isIgnored(start, true)) {
+            ++counts.prunedDirectories;
+            continue;
+        }
+        rules.addGitIgnoresDownTo(start);
+
+        QStringList pending{start};
+        while (!pending.isEmpty()) {
+            // Walking a large tree takes a while too; check now and then
+            if (++counts.directories % 64 == 0 && cancelled && cancelled())
+                break;
+            const QString directory = pending.takeLast();
+
+            // The listing comes with entry types, so only the PHP files that
+            // are kept need a stat for their size and modification time
+            QStringList subdirectories;
+            QVector<QFileInfo> phpFiles;
+            bool hasGitIgnore = false;
+            QDirIterator it(directory, QDir::Files | QDir::Dirs | QDir::Hidden | QDir::NoDotAndDotDot);
+            while (it.hasNext()) {
+                it.next();
+                const QFileInfo info = it.fileInfo();
+                const QString name = info.fileName();
+                if (name.startsWith('.')) {
+                    hasGitIgnore = hasGitIgnore || name == QLatin1String(".gitignore");
+                    continue;
+                }
+                if (info.isDir()) {
+                    if (!info.isSymLink())
+                        subdirectories.append(info.filePath());
+                } else if (name.endsWith(QLatin1String(".php"))) {
+                    phpFiles.append(info);
+                }
+            }
+            if (hasGitIgnore)
+                rules.addGitIgnore(directory);
+
+            for (const QFileInfo &info : std::as_const(phpFiles)) {
+                if (rules.ignoresEntry(info.filePath(), false)) {
+                    ++counts.ignoredFiles;
+                    continue;
+                }
+                files.append(ScannedFile{info.filePath(), info.lastModified().toMSecsSinceEpoch(), info.size()});
+                ++counts.files;
+                counts.bytes += info.size();
+            }
+            // Reversed, so the stack visits them in listing order
+            for (auto sub = subdirectories.crbegin(); sub != subdirectories.crend(); ++sub) {
+                if (rules.ignoresEntry(*sub, true))
+                    ++counts.prunedDirectories;
+                else
+                    pending.append(*sub);
+            }
+        }
+    }
+
+    if (stats)
+        *stats = counts;
+    return files;
+}
+
+void ProjectScanner::addConsumer(ScanConsumer *consumer)
+{
+    consumers.append(consumer);
+}
+
+bool ProjectScanner::run(const QString &projectPath, const QVector<ScannedFile> &files, const CancelCheck &cancelled,
+                         const ProgressCallback &progress)
+{
+    readCount = 0;
+    readBytes = 0;
+
+    // One bit per consumer and file; a file is read if any bit is set
+    QVector<quint32> wantedBy(files.size(), 0);
+    for (int c = 0; c < consumers.size(); ++c) {
+        Q_ASSERT(c < 32);
+        const QVector<int> wanted = consumers.at(c)->prepare(projectPath, files);
+        for (int fileIndex : wanted) {
+            wantedBy[fileIndex] |= 1u << c;
+        }
+    }
+    QVector<int> toRead;
+    for (int i = 0; i < files.size(); ++i) {
+        if (wantedBy.at(i))
+            toRead.append(i);
+    }
+
+    // Workers take the next file from a shared counter, so a few large
+    // files don't leave threads idle
+    QAtomicInt nextFile(0);
+    QAtomicInt filesDone(0);
+    QAtomicInteger<qint64> bytes(0);
+    const int workers = qMin(toRead.size(), pool->maxThreadCount());
+    for (int worker = 0; worker < workers; ++worker) {
+        pool->start([this, &files, &wantedBy, &toRead, &nextFile, &filesDone, &bytes, &cancelled]() {
+            for (int i = nextFile.fetchAndAddRelaxed(1); i < toRead.size(); i = nextFile.fetchAndAddRelaxed(1)) {
+                if (cancelled && cancelled())
+                    return;
+                const int fileIndex = toRead.at(i);
+                const quint32 mask = wantedBy.at(fileIndex);
+
+                QFile file(files.at(fileIndex).filePath);
+                if (!file.open(QIODevice::ReadOnly)) {
+                    qWarning() << "Could not open file for scanning:" << file.fileName();
+                    for (int c = 0; c < consumers.size(); ++c) {
+                        if (mask & (1u << c))
+                            consumers.at(c)->readFailed(fileIndex);
+                    }
+                    filesDone.fetchAndAddRelaxed(1);
+                    continue;
+                }
+
+                const qint64 size = file.size();
+                uchar *mapped = size >= MapThreshold ? file.map(0, size) : nullptr;
+                const QByteArray content = mapped
+                    ? QByteArray::fromRawData(reinterpret_cast<const char *>(mapped), size)
+                    : file.readAll();
+                for (int c = 0; c < consumers.size(); ++c) {
+                    if (mask & (1u << c))
+                        consumers.at(c)->consume(fileIndex, content);
+                }
+                if (mapped)
+                    file.unmap(mapped);
+
+                bytes.fetchAndAddRelaxed(content.size());
+                filesDone.fetchAndAddRelaxed(1);
+            }
+        });
+    }
+    while (!pool->waitForDone(50)) {
+        if (progress && !(cancelled && cancelled()))
+            progress(filesDone.loadRelaxed(), toRead.size());
+    }
+
+    readCount = filesDone.loadRelaxed();
+    readBytes = bytes.loadRelaxed();
+    const bool completed = !(cancelled && cancelled());
+    for (ScanConsumer *consumer : std::as_const(consumers)) {
+        consumer->finish(completed);
+    }
+    return completed;
+}
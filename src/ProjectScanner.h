@@ -0,0 +1,92 @@
+#ifndef INCODE_PROJECTSCANNER_H
+#define INCODE_PROJECTSCANNER_H
+
+#include <QString>
+#include <QStringList>
+#include <QByteArray>
+#include <QVector>
+#include <functional>
+#include "IgnoreRules.h"
+
+class QThreadPool;
+
+// A file found by ProjectScanner::walk()
+struct ScannedFile {
+    QString filePath;
+    qint64 modified = 0; // msecs since epoch
+    qint64 size = -1;
+};
+
+// What a walk visited and what the ignore rules saved
+struct WalkStats {
+    int directories = 0;       // listed
+    int prunedDirectories = 0; // ignored, so never listed
+    int files = 0;             // PHP files kept (and stat'ed)
+    int ignoredFiles = 0;      // PHP files ignored in listed directories
+    qint64 bytes = 0;          // total size of the kept files
+};
+
+// Work done on the files of a scan: symbol extraction, clone tokenizing and
+// so on. Each consumer decides which files it needs (usually the ones its
+// cache doesn't cover); the scanner reads each of those once and hands the
+// same bytes to every consumer that asked for them.
+class ScanConsumer
+{
+public:
+    virtual ~ScanConsumer() = default;
+
+    // Called on the scanning thread before any file is read. Returns the
+    // indices of the files whose content is needed, in ascending order.
+    virtual QVector<int> prepare(const QString &projectPath, const QVector<ScannedFile> &files) = 0;
+    // Called from worker threads, concurrently for different files. The
+    // content may be memory-mapped and is only valid during the call.
+    virtual void consume(int fileIndex, const QByteArray &content) = 0;
+    // Called instead of consume() when a file could not be read
+    virtual void readFailed(int fileIndex) { Q_UNUSED(fileIndex); }
+    // Called on the scanning thread after the last file, or with
+    // completed = false when the scan was cancelled
+    virtual void finish(bool completed) { Q_UNUSED(completed); }
+};
+
+// Walks a project once and reads every file that any registered consumer
+// needs once, on a thread pool.
+class ProjectScanner
+{
+public:
+    // Returning true stops the walk or scan as soon as possible
+    using CancelCheck = std::function<bool()>;
+    // Called on the scanning thread while files are read
+    using ProgressCallback = std::function<void(int filesDone, int filesTotal)>;
+
+    explicit ProjectScanner(QThreadPool *pool);
+
+    // Every *.php file below roots that the rules don't exclude, in walk
+    // order. Ignored directories are not entered; hidden entries and
+    // symlinked directories are skipped. Stops early when cancelled.
+    static QVector<ScannedFile> walk(const QStringList &roots, const IgnoreRules &rules,
+                                     const CancelCheck &cancelled = CancelCheck(), WalkStats *stats = nullptr);
+
+    // Consumers are not owned and must outlive run()
+    void addConsumer(ScanConsumer *consumer);
+
+    // Prepares every consumer, reads the union of the files they asked for
+    // and finishes them. Returns false if the scan was cancelled.
+    bool run(const QString &projectPath, const QVector<ScannedFile> &files, const CancelCheck &cancelled,
+             const ProgressCallback &progress = ProgressCallback());
+
+    // Statistics of the last run
+    int filesRead() const { return readCount; }
+    qint64 bytesRead() const { return readBytes; }
+
+    // Files at least this large are memory-mapped; smaller ones are cheaper
+    // to read than to map
+    static constexpr qint64 MapThreshold = 64 * 1024;
+
+private:
+    QThreadPool *pool;
+    QVector<ScanConsumer *> consumers;
+    int readCount = 0;
+    qint64 readBytes = 0;
+};
+
+#endif // INCODE_PROJECTSCANNER_H
@@ -0,0 +1,409 @@
+#include "ProjectWatcher.h"
+#include <QFileSystemWatcher>
+#include <QThreadPool>
+#include <QTimer>
+#include <QDir>
+#include <QDirIterator>
+#include <QFileInfo>
+#include <QDateTime>
+#include <QDebug>
+#include <algorithm>
+
+ProjectWatcher::ProjectWatcher(QObject *parent)
+    : QObject(parent), watcher(new QFileSystemWatcher(this)), debounceTimer(new QTimer(this)),
+      sweepTimer(new QTimer(this)), walkPool(new QThreadPool(this))
+{
+    debounceTimer->setSingleShot(true);
+    debounceTimer->setInterval(300);
+    sweepTimer->setInterval(SweepIntervalMsecs);
+    // Walks run one at a time, in the order they were asked for
+    walkPool->setMaxThreadCount(1);
+
+    connect(watcher, &QFileSystemWatcher::directoryChanged, this, &ProjectWatcher::onDirectoryChanged);
+    connect(watcher, &QFileSystemWatcher::fileChanged, this, &ProjectWatcher::onFileChanged);
+    connect(debounceTimer, &QTimer::timeout, this, &ProjectWatcher::flushPendingChanges);
+    connect(sweepTimer, &QTimer::timeout, this, &ProjectWatcher::sweepStep);
+}
+
+ProjectWatcher::~ProjectWatcher()
+{
+    currentRoot.fetchAndAddOrdered(1);
+    walkPool->waitForDone();
+}
+
+void ProjectWatcher::setRootPath(const QString &rootPath)
+{
+    currentRoot.fetchAndAddOrdered(1);
+    debounceTimer->stop();
+    pendingFiles.clear();
+    pendingDirectories.clear();
+    filesByDirectory.clear();
+    ignoreFiles.clear();
+    rulesChanged = false;
+    recentFiles.clear();
+    sweepQueue.clear();
+
+    const QStringList watchedFiles = watcher->files();
+    const QStringList watchedDirectories = watcher->directories();
+    if (!watchedFiles.isEmpty())
+        watcher->removePaths(watchedFiles);
+    if (!watchedDirectories.isEmpty())
+        watcher->removePaths(watchedDirectories);
+
+    root = rootPath;
+    ignoreRules = root.isEmpty() ? IgnoreRules() : IgnoreRules::forProject(root);
+    if (root.isEmpty()) {
+        sweepTimer->stop();
+        return;
+    }
+
+    // Nested .gitignore files are added as the walk finds them
+    watchIgnoreFile(root + "/.gitignore");
+    watchIgnoreFile(root + "/.incodeignore");
+    for (const QString &filePath : std::as_const(openFiles)) {
+        if (isProjectFile(filePath))
+            watchFile(filePath);
+    }
+    watchTree(root, false);
+    sweepTimer->start();
+}
+
+QString ProjectWatcher::rootPath() const
+{
+    return root;
+}
+
+void ProjectWatcher::setDebounceInterval(int msecs)
+{
+    debounceTimer->setInterval(msecs);
+}
+
+void ProjectWatcher::fileWritten(const QString &filePath)
+{
+    if (!isProjectFile(filePath))
+        return;
+
+    // Keep the listing current, so the next event in its directory doesn't
+    // report the file a second time
+    const QFileInfo info(filePath);
+    auto known = filesByDirectory.find(info.path());
+    if (known != filesByDirectory.end())
+        known->insert(filePath, FileStamp{info.lastModified().toMSecsSinceEpoch(), info.size()});
+    pendingFiles.insert(filePath);
+    debounceTimer->start();
+}
+
+void ProjectWatcher::addOpenFile(const QString &filePath)
+{
+    openFiles.insert(filePath);
+    if (isProjectFile(filePath))
+        watchFile(filePath);
+}
+
+void ProjectWatcher::removeOpenFile(const QString &filePath)
+{
+    openFiles.remove(filePath);
+    unwatchFile(filePath);
+}
+
+void ProjectWatcher::onDirectoryChanged(const QString &directoryPath)
+{
+    pendingDirectories.insert(directoryPath);
+    debounceTimer->start();
+}
+
+void ProjectWatcher::onFileChanged(const QString &filePath)
+{
+    if (ignoreFiles.contains(filePath)) {
+        rulesChanged = true;
+        debounceTimer->start();
+        return;
+    }
+
+    // An open or recent file was written in place, replaced or deleted
+    const QFileInfo info(filePath);
+    auto known = filesByDirectory.find(info.path());
+    if (known != filesByDirectory.end()) {
+        if (info.exists())
+            known->insert(filePath, FileStamp{info.lastModified().toMSecsSinceEpoch(), info.size()});
+        else
+            known->remove(filePath);
+    }
+    // Saving by renaming replaces the file, which drops its watch
+    if (info.exists())
+        watchFile(filePath);
+    pendingFiles.insert(filePath);
+    debounceTimer->start();
+}
+
+void ProjectWatcher::flushPendingChanges()
+{
+    // Directory events cover files that were added, removed, renamed over
+    // or had their attributes changed
+    for (const QString &directoryPath : std::as_const(pendingDirectories)) {
+        rescanDirectory(directoryPath);
+    }
+    pendingDirectories.clear();
+
+    if (rulesChanged) {
+        // Any file may have joined or left the project: start over with the
+        // new rules. The full re-index this asks for covers pendingFiles.
+        qDebug() << "Project watcher: ignore rules changed, watching" << root << "again";
+        setRootPath(root);
+        emit ignoreRulesChanged();
+        return;
+    }
+
+    if (pendingFiles.isEmpty())
+        return;
+
+    QStringList changedFiles(pendingFiles.cbegin(), pendingFiles.cend());
+    pendingFiles.clear();
+    changedFiles.sort();
+
+    qDebug() << "Project watcher: reporting" << changedFiles.size() << "changed files";
+    addRecentFiles(changedFiles);
+    emit filesChanged(changedFiles);
+}
+
+void ProjectWatcher::sweepStep()
+{
+    // A round lists every watched directory once, SweepFilesPerStep files
+    // at a time
+    if (sweepQueue.isEmpty())
+        sweepQueue = filesByDirectory.keys();
+
+    const int pendingBefore = pendingFiles.size();
+    const bool rulesBefore = rulesChanged;
+    int files = 0;
+    while (!sweepQueue.isEmpty() && files < SweepFilesPerStep) {
+        const QString directoryPath = sweepQueue.takeLast();
+        // Gone since the round started, with a parent that was found missing
+        if (!filesByDirectory.contains(directoryPath))
+            continue;
+        files += filesByDirectory.value(directoryPath).size() + 1;
+        rescanDirectory(directoryPath);
+    }
+    if (pendingFiles.size() != pendingBefore || rulesChanged != rulesBefore)
+        debounceTimer->start();
+}
+
+ProjectWatcher::DirectoryListing ProjectWatcher::listDirectory(const QString &directoryPath, IgnoreRules &rules)
+{
+    // The listing comes with entry types, so only the PHP files that are
+    // kept need a stat
+    DirectoryListing listing;
+    QVector<QFileInfo> phpFiles;
+    QDirIterator it(directoryPath, QDir::Files | QDir::Dirs | QDir::Hidden | QDir::NoDotAndDotDot);
+    while (it.hasNext()) {
+        it.next();
+        const QFileInfo info = it.fileInfo();
+        const QString name = info.fileName();
+        if (name.startsWith('.')) {
+            listing.hasGitIgnore = listing.hasGitIgnore || name == QLatin1String(".gitignore");
+            continue;
+        }
+        if (info.isDir()) {
+            if (!info.isSymLink())
+                listing.subdirectories.append(info.filePath());
+        } else if (name.endsWith(QLatin1String(".php"))) {
+            phpFiles.append(info);
+        }
+    }
+    if (listing.hasGitIgnore)
+        rules.addGitIgnore(directoryPath);
+
+    for (const QFileInfo &info : std::as_const(phpFiles)) {
+        if (!rules.ignoresEntry(info.filePath(), false))
+            listing.files.insert(info.filePath(), FileStamp{info.lastModified().toMSecsSinceEpoch(), info.size()});
+    }
+    listing.subdirectories.erase(std::remove_if(listing.subdirectories.begin(), listing.subdirectories.end(),
+                                                [&rules](const QString &path) { return rules.ignoresEntry(path, true); }),
+                                 listing.subdirectories.end());
+    return listing;
+}
+
+ProjectWatcher::TreeListing ProjectWatcher::listTree(const QString &directoryPath, IgnoreRules rules,
+                                                     const std::function<bool()> &cancelled)
+{
+    TreeListing tree;
+    rules.addGitIgnoresDownTo(QFileInfo(directoryPath).path());
+    if (rules.isIgnored(directoryPath, true))
+        return tree;
+
+    QStringList pending{directoryPath};
+    int listed = 0;
+    while (!pending.isEmpty()) {
+        if (++listed % 64 == 0 && cancelled())
+            break;
+        const QString directory = pending.takeLast();
+        const DirectoryListing listing = listDirectory(directory, rules);
+        if (listing.hasGitIgnore)
+            tree.gitIgnoreDirectories.append(directory);
+        tree.filesByDirectory.insert(directory, listing.files);
+        pending += listing.subdirectories;
+    }
+    return tree;
+}
+
+void ProjectWatcher::watchTree(const QString &directoryPath, bool reportFiles)
+{
+    const int rootJob = currentRoot.loadAcquire();
+    const IgnoreRules rules = ignoreRules;
+    walkPool->start([this, rootJob, directoryPath, rules, reportFiles]() {
+        const TreeListing listing = listTree(directoryPath, rules, [this, rootJob]() {
+            return currentRoot.loadAcquire() != rootJob;
+        });
+        // Handled on the GUI thread, unless the root changed meanwhile
+        QMetaObject::invokeMethod(this, [this, rootJob, listing, reportFiles]() {
+            if (currentRoot.loadAcquire() == rootJob)
+                addListing(listing, reportFiles);
+        }, Qt::QueuedConnection);
+    });
+}
+
+void ProjectWatcher::addListing(const TreeListing &listing, bool reportFiles)
+{
+    for (const QString &directory : listing.gitIgnoreDirectories) {
+        ignoreRules.addGitIgnore(directory);
+        watchIgnoreFile(directory + "/.gitignore");
+    }
+
+    // A directory can be listed twice when it changes while its tree is
+    // walked; the listing that arrived first stays
+    QStringList directories;
+    int fileCount = 0;
+    for (auto it = listing.filesByDirectory.cbegin(); it != listing.filesByDirectory.cend(); ++it) {
+        if (filesByDirectory.contains(it.key()))
+            continue;
+        filesByDirectory.insert(it.key(), it.value());
+        directories.append(it.key());
+        fileCount += it.value().size();
+        if (reportFiles) {
+            for (auto file = it.value().cbegin(); file != it.value().cend(); ++file) {
+                pendingFiles.insert(file.key());
+            }
+        }
+    }
+
+    // inotify watches are a limited resource; Qt falls back to polling for
+    // paths it can't watch natively
+    if (!directories.isEmpty())
+        watcher->addPaths(directories);
+    if (reportFiles && fileCount > 0)
+        debounceTimer->start();
+    else if (!reportFiles)
+        qDebug() << "Watching" << directories.size() << "directories with" << fileCount << "files under" << root;
+}
+
+void ProjectWatcher::rescanDirectory(const QString &directoryPath)
+{
+    if (!QFileInfo(directoryPath).isDir()) {
+        // The directory is gone: so is everything that was known below it
+        const QString prefix = directoryPath + QLatin1Char('/');
+        for (auto it = filesByDirectory.begin(); it != filesByDirectory.end();) {
+            if (it.key() == directoryPath || it.key().startsWith(prefix)) {
+                for (auto file = it.value().cbegin(); file != it.value().cend(); ++file) {
+                    pendingFiles.insert(file.key());
+                }
+                it = filesByDirectory.erase(it);
+            } else {
+                ++it;
+            }
+        }
+        return;
+    }
+
+    auto known = filesByDirectory.find(directoryPath);
+    if (known == filesByDirectory.end()) {
+        // A directory we never saw (e.g. moved into the project)
+        watchTree(directoryPath, true);
+        return;
+    }
+
+    checkIgnoreFile(directoryPath + "/.gitignore");
+    if (directoryPath == root)
+        checkIgnoreFile(root + "/.incodeignore");
+
+    // Added, removed and replaced files all need re-indexing
+    const DirectoryListing listing = listDirectory(directoryPath, ignoreRules);
+    for (auto file = listing.files.cbegin(); file != listing.files.cend(); ++file) {
+        const auto old = known->constFind(file.key());
+        if (old == known->constEnd() || *old != file.value())
+            pendingFiles.insert(file.key());
+    }
+    for (auto file = known->cbegin(); file != known->cend(); ++file) {
+        if (!listing.files.contains(file.key()))
+            pendingFiles.insert(file.key());
+    }
+    *known = listing.files;
+
+    // New subdirectories
+    for (const QString &subdirectory : listing.subdirectories) {
+        if (!filesByDirectory.contains(subdirectory))
+            watchTree(subdirectory, true);
+    }
+}
+
+ProjectWatcher::FileStamp ProjectWatcher::stampOf(const QString &filePath)
+{
+    const QFileInfo info(filePath);
+    return info.exists() ? FileStamp{info.lastModified().toMSecsSinceEpoch(), info.size()} : FileStamp();
+}
+
+void ProjectWatcher::watchIgnoreFile(const QString &filePath)
+{
+    const FileStamp stamp = stampOf(filePath);
+    ignoreFiles.insert(filePath, stamp);
+    if (stamp.size >= 0 && !watcher->files().contains(filePath))
+        watcher->addPath(filePath);
+}
+
+void ProjectWatcher::checkIgnoreFile(const QString &filePath)
+{
+    // Editors that save by renaming replace the file, which drops its watch
+    // but shows up as an event in its directory
+    if (stampOf(filePath) != ignoreFiles.value(filePath))
+        rulesChanged = true;
+}
+
+bool ProjectWatcher::isProjectFile(const QString &filePath)
+{
+    const QFileInfo info(filePath);
+    if (root.isEmpty() || info.suffix() != "php" || !filePath.startsWith(QDir::cleanPath(root) + '/'))
+        return false;
+    ignoreRules.addGitIgnoresDownTo(info.path());
+    return !ignoreRules.isIgnored(filePath, false);
+}
+
+void ProjectWatcher::watchFile(const QString &filePath)
+{
+    if (QFileInfo::exists(filePath) && !watcher->files().contains(filePath))
+        watcher->addPath(filePath);
+}
+
+void ProjectWatcher::unwatchFile(const QString &filePath)
+{
+    if (openFiles.contains(filePath) || recentFiles.contains(filePath) || ignoreFiles.contains(filePath))
+        return;
+    if (watcher->files().contains(filePath))
+        watcher->removePath(filePath);
+}
+
+void ProjectWatcher::addRecentFiles(const QStringList &filePaths)
+{
+    // Generators tend to rewrite the same files again; a branch switch only
+    // leaves its last few files
+    const int first = qMax(0, int(filePaths.size()) - MaxRecentFiles);
+    for (int i = first; i < filePaths.size(); ++i) {
+        const QString &filePath = filePaths.at(i);
+        recentFiles.removeOne(filePath);
+        if (QFileInfo::exists(filePath)) {
+            recentFiles.append(filePath);
+            watchFile(filePath);
+        }
+    }
+    while (recentFiles.size() > MaxRecentFiles) {
+        unwatchFile(recentFiles.takeFirst());
+    }
+}
@@ -0,0 +1,144 @@
+#ifndef INCODE_PROJECTWATCHER_H
+#define INCODE_PROJECTWATCHER_H
+
+#include <QObject>
+#include <QString>
+#include <QStringList>
+#include <QHash>
+#include <QSet>
+#include <QAtomicInt>
+#include <functional>
+#include "IgnoreRules.h"
+
+class QFileSystemWatcher;
+class QThreadPool;
+class QTimer;
+
+// Watches the directories of a project that its ignore rules don't exclude,
+// and reports changed PHP files in batches. Directories get one inotify
+// watch each rather than one per file: a directory event has that
+// directory listed again, and the modification times and sizes in the
+// listing tell which files were added, removed or replaced. A file
+// rewritten in place (a code generator, file_put_contents, an editor that
+// doesn't save by renaming) raises no directory event, so such writes are
+// caught three ways: open files and the files of recent batches get a
+// watch of their own, the application reports its own saves with
+// fileWritten(), and a sweep lists a few directories every second, so any
+// other in-place write is seen within one round over the project. The
+// .gitignore files and .incodeignore are watched too; when one changes,
+// the rules are rebuilt and ignoreRulesChanged() asks for a full re-index.
+// The tree is walked on a worker thread, so opening a large project doesn't
+// block the GUI. Events are debounced: every new event restarts a short
+// timer, so a branch switch touching thousands of files produces a single
+// filesChanged().
+class ProjectWatcher : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit ProjectWatcher(QObject *parent = nullptr);
+    ~ProjectWatcher() override;
+
+    void setRootPath(const QString &rootPath);
+    QString rootPath() const;
+
+    // Quiet period after the last event before a batch is reported
+    void setDebounceInterval(int msecs);
+
+    // Reports a file the application wrote, which no directory event may cover
+    void fileWritten(const QString &filePath);
+    // Open files are watched on their own while they are open, so writes by
+    // other programs show up at once
+    void addOpenFile(const QString &filePath);
+    void removeOpenFile(const QString &filePath);
+
+    // Files of recent batches that keep a watch of their own
+    static constexpr int MaxRecentFiles = 256;
+    // Time between two sweep steps, and files a step may re-stat
+    static constexpr int SweepIntervalMsecs = 1000;
+    static constexpr int SweepFilesPerStep = 2000;
+
+signals:
+    // Paths of PHP files that were created, modified or deleted. Callers can
+    // tell deletions apart by checking whether the file still exists.
+    void filesChanged(const QStringList &filePaths);
+    // Files may have joined or left the project; the watch has started over
+    void ignoreRulesChanged();
+
+private slots:
+    void onDirectoryChanged(const QString &directoryPath);
+    void onFileChanged(const QString &filePath);
+    void flushPendingChanges();
+    void sweepStep();
+
+private:
+    // Modification time and size of a PHP file when its directory was listed
+    struct FileStamp {
+        qint64 modified = 0;
+        qint64 size = -1;
+        bool operator==(const FileStamp &other) const { return modified == other.modified && size == other.size; }
+        bool operator!=(const FileStamp &other) const { return !(*this == other); }
+    };
+    using DirectoryFiles = QHash<QString, FileStamp>;
+
+    struct DirectoryListing {
+        DirectoryFiles files;
+        QStringList subdirectories;
+        bool hasGitIgnore = false;
+    };
+
+    // Every directory of a subtree the rules keep, with its PHP files
+    struct TreeListing {
+        QHash<QString, DirectoryFiles> filesByDirectory;
+        QStringList gitIgnoreDirectories; // the ones with a .gitignore
+    };
+
+    // Lists one directory, adding its .gitignore to rules first
+    static DirectoryListing listDirectory(const QString &directoryPath, IgnoreRules &rules);
+    // Runs on the walk pool; returns what was listed so far when cancelled
+    static TreeListing listTree(const QString &directoryPath, IgnoreRules rules,
+                                const std::function<bool()> &cancelled);
+
+    // Lists a subtree in the background and then watches its directories.
+    // With reportFiles, its PHP files are reported as changed.
+    void watchTree(const QString &directoryPath, bool reportFiles);
+    void addListing(const TreeListing &listing, bool reportFiles);
+    void rescanDirectory(const QString &directoryPath);
+
+    // The stamp of a file, or a default one if it doesn't exist
+    static FileStamp stampOf(const QString &filePath);
+    // Records an ignore file's stamp and watches the file if it exists
+    void watchIgnoreFile(const QString &filePath);
+    // Flags a rebuild if the ignore file appeared, disappeared or was replaced
+    void checkIgnoreFile(const QString &filePath);
+    // Whether filePath is a PHP file of the project that the rules keep
+    bool isProjectFile(const QString &filePath);
+    // Gives a file its own watch, or drops it once it is neither open nor
+    // recent
+    void watchFile(const QString &filePath);
+    void unwatchFile(const QString &filePath);
+    void addRecentFiles(const QStringList &filePaths);
+
+    QFileSystemWatcher *watcher;
+    QTimer *debounceTimer;
+    QTimer *sweepTimer;
+    QThreadPool *walkPool;
+    QString root;
+    IgnoreRules ignoreRules;
+    // Bumped for every root; walks for an older one stop and are dropped
+    QAtomicInt currentRoot;
+    // Watched directory -> PHP files directly inside it
+    QHash<QString, DirectoryFiles> filesByDirectory;
+    QSet<QString> pendingFiles;
+    QSet<QString> pendingDirectories;
+    // .gitignore and .incodeignore files the rules were built from
+    QHash<QString, FileStamp> ignoreFiles;
+    bool rulesChanged = false;
+    // Files with a watch of their own; they stay open across roots
+    QSet<QString> openFiles;
+    QStringList recentFiles; // least recently changed first
+    // Directories the sweep has yet to list in this round
+    QStringList sweepQueue;
+};
+
+#endif // INCODE_PROJECTWATCHER_H
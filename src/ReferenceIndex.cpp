@@ -0,0 +1,93 @@
+#include "ReferenceIndex.h"
+#include "Varint.h"
+#include <cstring>
+
+ReferenceIndex ReferenceIndex::build(const SymbolTable &symbols, const QHash<QString, IndexedFile> &files)
+{
+    const int nameCount = symbols.nameCount();
+    QVector<QByteArray> lists(nameCount);
+    QVector<quint32> lastFile(nameCount, 0);
+    QVector<quint32> lastLine(nameCount, 0);
+
+    // Files are visited in file ID order, so every list is appended in
+    // (file, line) order and all deltas are non-negative
+    for (int fileId = 0; fileId < symbols.fileCount(); ++fileId) {
+        const auto file = files.constFind(symbols.filePath(fileId));
+        if (file == files.constEnd())
+            continue;
+
+        const char *name = file->referenceNames.constData();
+        const char *namesEnd = name + file->referenceNames.size();
+        const char *lines = file->referenceLines.constData();
+        const char *linesEnd = lines + file->referenceLines.size();
+
+        while (name < namesEnd) {
+            const char *terminator = static_cast<const char *>(std::memchr(name, '\0', size_t(namesEnd - name)));
+            if (!terminator)
+                break;
+            const int id = symbols.nameId(QByteArray::fromRawData(name, int(terminator - name)));
+            name = terminator + 1;
+
+            const quint32 count = readVarint(lines, linesEnd);
+            quint32 line = 0;
+            for (quint32 i = 0; i < count; ++i) {
+                line += readVarint(lines, linesEnd);
+                if (id < 0)
+                    continue; // used but never defined in the project
+
+                QByteArray &list = lists[id];
+                if (lastFile.at(id) != quint32(fileId)) {
+                    appendVarint(list, quint32(fileId) - lastFile.at(id));
+                    lastFile[id] = quint32(fileId);
+                    lastLine[id] = 0;
+                } else {
+                    appendVarint(list, 0);
+                }
+                appendVarint(list, line - lastLine.at(id));
+                lastLine[id] = line;
+            }
+        }
+    }
+
+    ReferenceIndex index;
+    qsizetype totalSize = 0;
+    for (const QByteArray &list : std::as_const(lists)) {
+        totalSize += list.size();
+    }
+    index.postings.reserve(totalSize);
+    index.offsets.reserve(nameCount + 1);
+    for (const QByteArray &list : std::as_const(lists)) {
+        index.offsets.append(quint32(index.postings.size()));
+        index.postings.append(list);
+    }
+    index.offsets.append(quint32(index.postings.size()));
+    return index;
+}
+
+QList<SymbolLocation> ReferenceIndex::find(const SymbolTable &symbols, const QString &name) const
+{
+    QList<SymbolLocation> references;
+    const int id = symbols.nameId(name);
+    if (id < 0 || id + 1 >= offsets.size())
+        return references;
+
+    const char *pos = postings.constData() + offsets.at(id);
+    const char *end = postings.constData() + offsets.at(id + 1);
+    quint32 fileId = 0;
+    quint32 line = 0;
+    while (pos < end) {
+        const quint32 fileDelta = readVarint(pos, end);
+        if (fileDelta != 0) {
+            fileId += fileDelta;
+            line = 0;
+        }
+        line += readVarint(pos, end);
+        references.append(SymbolLocation{symbols.filePath(int(fileId)), int(line)});
+    }
+    return references;
+}
+
+qsizetype ReferenceIndex::memoryUsage() const
+{
+    return postings.capacity() + offsets.capacity() * qsizetype(sizeof(quint32));
+}
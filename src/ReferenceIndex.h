@@ -0,0 +1,34 @@
+#ifndef INCODE_REFERENCEINDEX_H
+#define INCODE_REFERENCEINDEX_H
+
+#include "ISymbolProvider.h"
+#include "SymbolIndexCache.h"
+#include "SymbolTable.h"
+#include <QByteArray>
+#include <QHash>
+#include <QList>
+#include <QVector>
+
+// Where each defined name is used. Only names that have a definition in the
+// SymbolTable get a posting list. Lists are indexed by the table's name IDs
+// and delta-encoded as varints: for every (file, line) occurrence a file ID
+// delta (0 = same file as before) and a line delta (from the previous line in
+// that file, or from 0 in a new file). That's typically 2 bytes a reference.
+class ReferenceIndex
+{
+public:
+    ReferenceIndex() = default;
+
+    static ReferenceIndex build(const SymbolTable &symbols, const QHash<QString, IndexedFile> &files);
+
+    // Use sites of a name (declarations included), ordered by file and line
+    QList<SymbolLocation> find(const SymbolTable &symbols, const QString &name) const;
+
+    qsizetype memoryUsage() const;
+
+private:
+    QByteArray postings;
+    QVector<quint32> offsets; // name ID -> start of its list, plus an end marker
+};
+
+#endif // INCODE_REFERENCEINDEX_H
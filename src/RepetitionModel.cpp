@@ -0,0 +1,127 @@
+#include "RepetitionModel.h"
+#include <QDir>
+
+namespace {
+// Previews kept in the cache, counted in lines
+const int SnippetCacheLines = 20000;
+}
+
+RepetitionModel::RepetitionModel(QObject *parent)
+    : QAbstractItemModel(parent), groupStarts({0}), snippetProvider(&CodeAnalyzer::snippet), snippets(SnippetCacheLines)
+{
+}
+
+void RepetitionModel::setResults(const RepetitionResults &newResults, const QString &rootPath)
+{
+    beginResetModel();
+    results = newResults;
+    snippets.clear();
+
+    const QDir root(rootPath);
+    displayPaths.clear();
+    displayPaths.reserve(results.files.size());
+    for (const QString &path : std::as_const(results.files)) {
+        displayPaths.append(root.relativeFilePath(path));
+    }
+
+    // Repetitions arrive grouped, so each group is a contiguous range
+    groupStarts.clear();
+    for (int i = 0; i < results.repetitions.size(); ++i) {
+        if (i == 0 || results.repetitions.at(i).groupId != results.repetitions.at(i - 1).groupId)
+            groupStarts.append(i);
+    }
+    groupStarts.append(results.repetitions.size());
+    endResetModel();
+}
+
+void RepetitionModel::clear()
+{
+    setResults(RepetitionResults(), QString());
+}
+
+void RepetitionModel::setSnippetProvider(const SnippetProvider &provider)
+{
+    snippetProvider = provider;
+    snippets.clear();
+}
+
+QModelIndex RepetitionModel::index(int row, int column, const QModelIndex &parent) const
+{
+    if (!hasIndex(row, column, parent))
+        return QModelIndex();
+    // Group rows carry 0, copies the 1-based row of their group
+    return createIndex(row, column, parent.isValid() ? quintptr(parent.row() + 1) : quintptr(0));
+}
+
+QModelIndex RepetitionModel::parent(const QModelIndex &child) const
+{
+    if (!child.isValid() || child.internalId() == 0)
+        return QModelIndex();
+    return createIndex(int(child.internalId() - 1), 0, quintptr(0));
+}
+
+int RepetitionModel::rowCount(const QModelIndex &parent) const
+{
+    if (!parent.isValid())
+        return groupCount();
+    if (parent.internalId() != 0 || parent.column() != 0)
+        return 0;
+    return groupStarts.at(parent.row() + 1) - groupStarts.at(parent.row());
+}
+
+int RepetitionModel::columnCount(const QModelIndex &) const
+{
+    return 1;
+}
+
+const CodeRepetition &RepetitionModel::repetitionAt(const QModelIndex &index) const
+{
+    if (index.internalId() == 0)
+        return results.repetitions.at(groupStarts.at(index.row()));
+    return results.repetitions.at(groupStarts.at(int(index.internalId() - 1)) + index.row());
+}
+
+QString RepetitionModel::snippetFor(int repetition) const
+{
+    if (const QString *cached = snippets.object(repetition))
+        return *cached;
+    const CodeRepetition &rep = results.repetitions.at(repetition);
+    const QString text = snippetProvider(results.filePath(rep), rep.startLine, rep.endLine);
+    snippets.insert(repetition, new QString(text), qMax(1, rep.endLine - rep.startLine + 1));
+    return text;
+}
+
+QVariant RepetitionModel::data(const QModelIndex &index, int role) const
+{
+    if (!index.isValid())
+        return QVariant();
+
+    const bool isGroup = index.internalId() == 0;
+    const CodeRepetition &rep = repetitionAt(index);
+    switch (role) {
+    case Qt::DisplayRole:
+        if (isGroup && !results.similarities.isEmpty()) {
+            return QString("#%1  %2% similar, %3 lines")
+                .arg(rep.groupId + 1)
+                .arg(qRound(results.similarities.at(rep.groupId) * 100))
+                .arg(rep.endLine - rep.startLine + 1);
+        }
+        if (isGroup) {
+            return QString("#%1  %2 copies, %3 lines")
+                .arg(rep.groupId + 1)
+                .arg(rowCount(index))
+                .arg(rep.endLine - rep.startLine + 1);
+        }
+        return QString("%1:%2-%3").arg(displayPaths.at(rep.fileId)).arg(rep.startLine).arg(rep.endLine);
+    case Qt::ToolTipRole:
+        return snippetFor(int(&rep - results.repetitions.constData()));
+    case FilePathRole:
+        return results.filePath(rep);
+    case StartLineRole:
+        return rep.startLine;
+    case EndLineRole:
+        return rep.endLine;
+    default:
+        return QVariant();
+    }
+}
@@ -0,0 +1,57 @@
+#ifndef INCODE_REPETITIONMODEL_H
+#define INCODE_REPETITIONMODEL_H
+
+#include <QAbstractItemModel>
+#include <QCache>
+#include <functional>
+#include "CodeAnalyzer.h"
+
+// Two-level view of analysis results: one top-level row per clone class
+// (or pair of similar functions), with its copies as children. Rows are
+// built from RepetitionResults on request, so setting 100k results costs
+// one pass over the records and snippet previews are only read for
+// tooltips that are actually shown.
+class RepetitionModel : public QAbstractItemModel
+{
+    Q_OBJECT
+
+public:
+    enum Roles {
+        FilePathRole = Qt::UserRole,
+        StartLineRole,
+        EndLineRole
+    };
+
+    // Returns the text of lines startLine..endLine of a file
+    using SnippetProvider = std::function<QString(const QString &filePath, int startLine, int endLine)>;
+
+    explicit RepetitionModel(QObject *parent = nullptr);
+
+    void setResults(const RepetitionResults &results, const QString &rootPath);
+    void clear();
+    // Defaults to reading from disk with CodeAnalyzer::snippet()
+    void setSnippetProvider(const SnippetProvider &provider);
+
+    int repetitionCount() const { return results.repetitions.size(); }
+    int groupCount() const { return groupStarts.size() - 1; }
+
+    QModelIndex index(int row, int column, const QModelIndex &parent = QModelIndex()) const override;
+    QModelIndex parent(const QModelIndex &child) const override;
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    int columnCount(const QModelIndex &parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
+
+private:
+    // Repetition shown by a child row, or the first copy for a group row
+    const CodeRepetition &repetitionAt(const QModelIndex &index) const;
+    QString snippetFor(int repetition) const;
+
+    RepetitionResults results;
+    QStringList displayPaths; // relative to the project, per file id
+    QVector<int> groupStarts; // first repetition of each group, plus the end
+    SnippetProvider snippetProvider;
+    // Recently shown previews, by repetition
+    mutable QCache<int, QString> snippets;
+};
+
+#endif // INCODE_REPETITIONMODEL_H
@@ -1,14 +1,76 @@
 #include "SimpleSymbolIndexer.h"
-#include <QFile>
-#include <QTextStream>
-#include <QRegularExpression>
-#include <QDirIterator>
+#include "PhpSymbolLexer.h"
+#include "ProjectScanner.h"
 #include <QDebug>
 #include <QDir>
+#include <QThreadPool>
+#include <QThread>
+#include <QAtomicInt>
+#include <QElapsedTimer>
+#include <QCryptographicHash>
+#include <QFile>
+#include <QFileInfo>
+#include <QDateTime>
+#include <QVector>
+#include <algorithm>
+
+namespace {
+
+// Parses the stale entries of one pass; scanned file i is entries[i]
+class EntryParser : public ScanConsumer
+{
+public:
+    EntryParser(QVector<IndexedFile> &entries, const QVector<int> &staleEntries)
+        : entries(entries), staleEntries(staleEntries), parsed(entries.size(), 0)
+    {
+    }
+
+    QVector<int> prepare(const QString &, const QVector<ScannedFile> &) override
+    {
+        QVector<int> wanted = staleEntries;
+        std::sort(wanted.begin(), wanted.end());
+        return wanted;
+    }
+
+    void consume(int fileIndex, const QByteArray &content) override
+    {
+        SimpleSymbolIndexer::parseContent(entries[fileIndex], content);
+        parsed[fileIndex] = 1;
+    }
+
+    void readFailed(int fileIndex) override
+    {
+        IndexedFile &entry = entries[fileIndex];
+        entry.contentHash.clear();
+        entry.symbols.clear();
+        entry.referenceNames.clear();
+        entry.referenceLines.clear();
+        parsed[fileIndex] = 1;
+    }
+
+    void finish(bool completed) override
+    {
+        if (completed)
+            return;
+        // Not parsed, so these must not be cached
+        for (int index : staleEntries) {
+            if (!parsed.at(index))
+                entries[index].filePath.clear();
+        }
+    }
+
+private:
+    QVector<IndexedFile> &entries;
+    const QVector<int> &staleEntries;
+    QVector<quint8> parsed;
+};
+
+} // namespace
 
 SimpleSymbolIndexer::SimpleSymbolIndexer(QObject *parent)
-    : QObject(parent)
+    : QObject(parent), currentSnapshot(std::make_shared<IndexSnapshot>()), workerPool(new QThreadPool(this))
 {
+    workerPool->setMaxThreadCount(QThread::idealThreadCount());
 }
 
 SimpleSymbolIndexer::~SimpleSymbolIndexer()
@@ -17,74 +79,403 @@ SimpleSymbolIndexer::~SimpleSymbolIndexer()
 
 SymbolLocation SimpleSymbolIndexer::findSymbolLocation(const QString &symbolName) const
 {
-    if (symbolMap.contains(symbolName)) {
-        return symbolMap.value(symbolName);
+    const QList<SymbolLocation> locations = snapshot()->symbols.find(symbolName);
+    if (!locations.isEmpty()) {
+        return locations.first();
     }
     return SymbolLocation{"", -1}; // Not found
 }
 
+QList<SymbolLocation> SimpleSymbolIndexer::findSymbolLocations(const QString &symbolName) const
+{
+    return snapshot()->symbols.find(symbolName);
+}
+
+SymbolLocation SimpleSymbolIndexer::resolveClass(const QString &qualifiedName)
+{
+    const std::shared_ptr<const IndexSnapshot> current = snapshot();
+    const QString filePath = current->autoloader.resolve(qualifiedName);
+    if (filePath.isEmpty())
+        return SymbolLocation{"", -1};
+
+    const QString className = qualifiedName.section('\\', -1);
+    auto isClassLike = [](SymbolKind kind) { return kind <= SymbolKind::Enum; };
+    const QList<SymbolLocation> indexed = current->symbols.find(className);
+    for (const SymbolLocation &location : indexed) {
+        if (location.filePath == filePath && isClassLike(location.kind))
+            return location;
+    }
+
+    // Not indexed (yet): parse just this file now, and let the indexing
+    // thread add it so its symbols and references show up from now on
+    QFile file(filePath);
+    if (!file.open(QIODevice::ReadOnly))
+        return SymbolLocation{"", -1};
+    IndexedFile entry;
+    parseContent(entry, file.readAll());
+    emit startLazyIndexing(QStringList() << filePath);
+    for (const IndexedSymbol &symbol : std::as_const(entry.symbols)) {
+        if (isClassLike(symbol.kind) && symbol.name.compare(className, Qt::CaseInsensitive) == 0)
+            return SymbolLocation{filePath, symbol.lineNumber, symbol.kind};
+    }
+    return SymbolLocation{filePath, 1, SymbolKind::Class};
+}
+
+QList<SymbolLocation> SimpleSymbolIndexer::findReferences(const QString &symbolName) const
+{
+    const std::shared_ptr<const IndexSnapshot> current = snapshot();
+    return current->references.find(current->symbols, symbolName);
+}
+
 QStringList SimpleSymbolIndexer::allSymbols() const
 {
-    return symbolMap.keys();
+    return snapshot()->symbols.names();
+}
+
+QStringList SimpleSymbolIndexer::completeSymbol(const QString &prefix, int limit) const
+{
+    return snapshot()->completions.complete(prefix, limit);
+}
+
+std::shared_ptr<const IndexSnapshot> SimpleSymbolIndexer::snapshot() const
+{
+    return std::atomic_load(&currentSnapshot);
+}
+
+void SimpleSymbolIndexer::setThreadCount(int count)
+{
+    workerPool->setMaxThreadCount(count > 0 ? count : QThread::idealThreadCount());
+}
+
+int SimpleSymbolIndexer::threadCount() const
+{
+    return workerPool->maxThreadCount();
+}
+
+void SimpleSymbolIndexer::setCacheEnabled(bool enabled)
+{
+    useCache = enabled;
+}
+
+void SimpleSymbolIndexer::addScanConsumer(const std::shared_ptr<ScanConsumer> &consumer)
+{
+    scanConsumers.append(consumer);
+}
+
+bool SimpleSymbolIndexer::cacheEnabled() const
+{
+    return useCache;
 }
 
 void SimpleSymbolIndexer::indexDirectory(const QString &directoryPath)
 {
-    // This method is called from the main thread to initiate indexing in the worker thread
-    emit startIndexing(directoryPath);
+    indexDirectory(directoryPath, QStringList());
+}
+
+void SimpleSymbolIndexer::indexDirectory(const QString &directoryPath, const QStringList &priorityFiles)
+{
+    // This method is called from the main thread to initiate indexing in the worker thread.
+    // Taking a new job number stops the running job at its next file
+    // boundary, so the request queued below starts almost immediately.
+    pendingJobs.fetchAndAddOrdered(1);
+    const int job = currentJob.fetchAndAddOrdered(1) + 1;
+    emit startIndexing(directoryPath, priorityFiles, job);
 }
 
-void SimpleSymbolIndexer::doIndexDirectory(const QString &directoryPath)
+void SimpleSymbolIndexer::cancelIndexing()
 {
+    currentJob.fetchAndAddOrdered(1);
+}
+
+void SimpleSymbolIndexer::doIndexDirectory(const QString &directoryPath, const QStringList &priorityFiles, int job)
+{
+    // Superseded or cancelled while still queued
+    if (isCancelled(job)) {
+        abandonJob(QVector<IndexedFile>(), false);
+        return;
+    }
+
     qDebug() << "Indexing started for directory:" << directoryPath;
-    symbolMap.clear(); // Clear existing symbols
+    QElapsedTimer timer;
+    timer.start();
+    autoloader = ComposerAutoloader::forProject(directoryPath);
+    // Readers keep the previous generation until the first new one is
+    // published, so navigation doesn't go blank while the cache loads
+    indexedFiles.clear();
+    projectPath = directoryPath;
+
+    SymbolIndexCache cache(directoryPath);
+    QHash<QString, IndexedFile> cachedFiles;
+    if (useCache) {
+        cache.load(cachedFiles);
+    }
+
+    // Reuse cached entries whose modification time and size still match; the
+    // rest are re-read. Whatever is left in cachedFiles afterwards was deleted.
+    QVector<IndexedFile> entries;
+    QVector<int> staleEntries;
+    int reparsedFiles = 0;
+    auto addEntry = [&](const QString &filePath, qint64 modified, qint64 size) {
+        IndexedFile entry = cachedFiles.take(filePath);
+        if (entry.filePath.isEmpty() || entry.modified != modified || entry.size != size) {
+            entry.filePath = filePath;
+            entry.modified = modified;
+            entry.size = size;
+            staleEntries.append(entries.size());
+        }
+        entries.append(entry);
+    };
+
+    // Files open in the editor go first and are published on their own, so
+    // navigation works in them while the rest of the project is read. They
+    // are checked against the nested .gitignore files above them too, so
+    // they are kept or left out just as the walk below does.
+    IgnoreRules ignoreRules = IgnoreRules::forProject(directoryPath);
+    const QString rootPrefix = QDir::cleanPath(directoryPath) + '/';
+    for (const QString &filePath : priorityFiles) {
+        const QFileInfo info(filePath);
+        if (!filePath.startsWith(rootPrefix) || !info.isFile() || info.suffix() != "php")
+            continue;
+        ignoreRules.addGitIgnoresDownTo(info.path());
+        if (!ignoreRules.isIgnored(filePath, false))
+            addEntry(filePath, info.lastModified().toMSecsSinceEpoch(), info.size());
+    }
+    if (!entries.isEmpty()) {
+        if (!parseEntries(entries, staleEntries, job, false, false)) {
+            abandonJob(entries, false);
+            return;
+        }
+        for (const IndexedFile &entry : std::as_const(entries)) {
+            indexedFiles.insert(entry.filePath, entry);
+        }
+        rebuildSymbolTable();
+        reparsedFiles += staleEntries.size();
+        staleEntries.clear();
+        qDebug() << "Indexed open files:" << entries.size() << "elapsed ms:" << timer.elapsed();
+    }
 
-    QDirIterator it(directoryPath, QStringList() << "*.php", QDir::Files | QDir::NoDotAndDotDot, QDirIterator::Subdirectories);
-    QList<QString> filesToProcess;
-    while (it.hasNext()) {
-        filesToProcess.append(it.next());
+    WalkStats walkStats;
+    const QVector<ScannedFile> files = ProjectScanner::walk(
+        QStringList() << directoryPath, ignoreRules,
+        [this, job]() { return isCancelled(job); }, &walkStats);
+    if (isCancelled(job)) {
+        abandonJob(entries, false);
+        return;
+    }
+
+    // Every walked file gets an entry, so scan consumers see the whole
+    // project; the open files are already parsed and not stale
+    entries.clear();
+    entries.reserve(files.size());
+    for (const ScannedFile &file : files) {
+        const auto indexed = indexedFiles.constFind(file.filePath);
+        if (indexed != indexedFiles.constEnd())
+            entries.append(*indexed);
+        else
+            addEntry(file.filePath, file.modified, file.size);
+    }
+    // Vendor files indexed on demand stay in the index, though the walk
+    // doesn't enter vendor/; files of another project are dropped
+    for (auto lazy = lazyFiles.begin(); lazy != lazyFiles.end();) {
+        const QFileInfo info(*lazy);
+        if (!lazy->startsWith(rootPrefix) || !info.isFile()) {
+            lazy = lazyFiles.erase(lazy);
+            continue;
+        }
+        if (!indexedFiles.contains(*lazy))
+            addEntry(*lazy, info.lastModified().toMSecsSinceEpoch(), info.size());
+        ++lazy;
+    }
+    reparsedFiles += staleEntries.size();
+    const bool cacheChanged = reparsedFiles > 0 || !cachedFiles.isEmpty();
+
+    if (!parseEntries(entries, staleEntries, job, true, true)) {
+        abandonJob(entries, true);
+        return;
     }
 
-    int totalFiles = filesToProcess.size();
-    for (int i = 0; i < totalFiles; ++i) {
-        indexFile(filesToProcess.at(i));
-        emit indexingProgress((i * 100) / totalFiles);
+    indexedFiles.reserve(entries.size());
+    for (const IndexedFile &entry : std::as_const(entries)) {
+        indexedFiles.insert(entry.filePath, entry);
     }
+    rebuildSymbolTable();
 
-    qDebug() << "Indexing finished. Total symbols:" << symbolMap.size();
+    if (useCache && cacheChanged) {
+        cache.save(indexedFiles);
+    }
+
+    const std::shared_ptr<const IndexSnapshot> published = snapshot();
+    qDebug() << "Indexing finished. Total symbols:" << published->symbols.symbolCount()
+             << "names:" << published->symbols.nameCount()
+             << "table bytes:" << published->symbols.memoryUsage()
+             << "reference bytes:" << published->references.memoryUsage()
+             << "files:" << entries.size() << "re-parsed:" << reparsedFiles
+             << "ignored files:" << walkStats.ignoredFiles << "pruned directories:" << walkStats.prunedDirectories
+             << "threads:" << workerPool->maxThreadCount()
+             << "elapsed ms:" << timer.elapsed();
+    pendingJobs.fetchAndAddOrdered(-1);
     emit indexingFinished();
 }
 
-void SimpleSymbolIndexer::indexFile(const QString &filePath)
+void SimpleSymbolIndexer::abandonJob(const QVector<IndexedFile> &entries, bool saveParsed)
 {
-    QFile file(filePath);
-    if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
-        qWarning() << "Could not open file for indexing:" << filePath;
+    // Only meaningful once the whole tree was walked: entries then covers
+    // every file, and the ones that were parsed don't need to be again
+    if (useCache && saveParsed) {
+        QHash<QString, IndexedFile> parsedFiles;
+        for (const IndexedFile &entry : entries) {
+            if (!entry.filePath.isEmpty())
+                parsedFiles.insert(entry.filePath, entry);
+        }
+        SymbolIndexCache(projectPath).save(parsedFiles);
+        qDebug() << "Indexing cancelled, kept" << parsedFiles.size() << "of" << entries.size() << "files for the next run";
+    }
+
+    // Readers keep whatever was published last; incremental updates stop
+    // until the next full index
+    indexedFiles.clear();
+    projectPath.clear();
+
+    if (pendingJobs.fetchAndAddOrdered(-1) == 1)
+        emit indexingCancelled();
+}
+
+void SimpleSymbolIndexer::doReindexFiles(const QStringList &filePaths)
+{
+    if (projectPath.isEmpty())
+        return;
+
+    QElapsedTimer timer;
+    timer.start();
+
+    QVector<IndexedFile> entries;
+    QVector<int> staleEntries;
+    int removedFiles = 0;
+    for (const QString &filePath : filePaths) {
+        const QFileInfo info(filePath);
+        if (!info.isFile()) {
+            removedFiles += indexedFiles.remove(filePath);
+            continue;
+        }
+
+        const qint64 modified = info.lastModified().toMSecsSinceEpoch();
+        IndexedFile entry = indexedFiles.value(filePath);
+        if (!entry.filePath.isEmpty() && entry.modified == modified && entry.size == info.size())
+            continue;
+
+        entry.filePath = filePath;
+        entry.modified = modified;
+        entry.size = info.size();
+        staleEntries.append(entries.size());
+        entries.append(entry);
+    }
+
+    if (staleEntries.isEmpty() && removedFiles == 0)
+        return;
+
+    QVector<QByteArray> previousHashes;
+    previousHashes.reserve(entries.size());
+    for (const IndexedFile &entry : std::as_const(entries)) {
+        previousHashes.append(entry.contentHash);
+    }
+
+    // A full index requested meanwhile replaces all of this anyway
+    if (!parseEntries(entries, staleEntries, currentJob.loadAcquire(), false, false))
         return;
+    bool contentChanged = removedFiles > 0;
+    for (int i = 0; i < entries.size(); ++i) {
+        contentChanged = contentChanged || entries.at(i).contentHash != previousHashes.at(i);
+        indexedFiles.insert(entries.at(i).filePath, entries.at(i));
+    }
+    // Every snapshot structure is rebuilt for the whole project, so touched
+    // but unchanged files (checkout, build step) only update their stamps
+    if (contentChanged)
+        rebuildSymbolTable();
+    if (useCache) {
+        SymbolIndexCache(projectPath).save(indexedFiles);
     }
 
-    QTextStream in(&file);
-    int lineNumber = 0;
-    while (!in.atEnd()) {
-        QString line = in.readLine();
-        lineNumber++;
+    qDebug() << "Incremental indexing finished. Re-parsed:" << staleEntries.size()
+             << "removed:" << removedFiles << "total symbols:" << snapshot()->symbols.symbolCount()
+             << "elapsed ms:" << timer.elapsed();
+    emit indexingFinished();
+}
+
+void SimpleSymbolIndexer::doIndexLazyFiles(const QStringList &filePaths)
+{
+    for (const QString &filePath : filePaths) {
+        lazyFiles.insert(filePath);
+    }
+    doReindexFiles(filePaths);
+}
 
-        // Simple regex for class and function names
-        QRegularExpression classRegex("\\bclass\\s+(\\w+)\\b");
-        QRegularExpressionMatch classMatch = classRegex.match(line);
-        if (classMatch.hasMatch()) {
-            QString className = classMatch.captured(1);
-            symbolMap.insert(className, SymbolLocation{filePath, lineNumber});
-            //qDebug() << "Found class:" << className << "in" << filePath << "at line" << lineNumber;
+bool SimpleSymbolIndexer::parseEntries(QVector<IndexedFile> &entries, const QVector<int> &staleEntries, int job,
+                                       bool reportProgress, bool withScanConsumers)
+{
+    QVector<ScannedFile> files;
+    files.reserve(entries.size());
+    for (const IndexedFile &entry : std::as_const(entries)) {
+        files.append(ScannedFile{entry.filePath, entry.modified, entry.size});
+    }
+
+    EntryParser parser(entries, staleEntries);
+    ProjectScanner scanner(workerPool);
+    scanner.addConsumer(&parser);
+    if (withScanConsumers) {
+        for (const std::shared_ptr<ScanConsumer> &consumer : std::as_const(scanConsumers)) {
+            scanner.addConsumer(consumer.get());
         }
+    }
 
-        QRegularExpression functionRegex("\\bfunction\\s+(\\w+)\\s*\\(\\)");
-        QRegularExpressionMatch functionMatch = functionRegex.match(line);
-        if (functionMatch.hasMatch()) {
-            QString functionName = functionMatch.captured(1);
-            symbolMap.insert(functionName, SymbolLocation{filePath, lineNumber});
-            //qDebug() << "Found function:" << functionName << "in" << filePath << "at line" << lineNumber;
+    // Report at most every ProgressIntervalMsecs and only when the value changed
+    QElapsedTimer sinceProgress;
+    sinceProgress.start();
+    int lastProgress = -1;
+    auto progress = [&](int filesDone, int filesTotal) {
+        if (!reportProgress || sinceProgress.elapsed() < ProgressIntervalMsecs)
+            return;
+        const int value = (filesDone * 100) / filesTotal;
+        if (value != lastProgress) {
+            lastProgress = value;
+            sinceProgress.restart();
+            emit indexingProgress(value);
         }
+    };
+    const bool completed = scanner.run(projectPath, files, [this, job]() { return isCancelled(job); }, progress);
+    if (scanner.filesRead() > 0) {
+        qDebug() << "Scanned" << scanner.filesRead() << "files," << scanner.bytesRead() << "bytes";
     }
-    file.close();
-}
\ No newline at end of file
+    return completed;
+}
+
+void SimpleSymbolIndexer::rebuildSymbolTable()
+{
+    publish(SymbolTable::fromFiles(indexedFiles));
+}
+
+void SimpleSymbolIndexer::publish(SymbolTable table)
+{
+    auto next = std::make_shared<IndexSnapshot>();
+    next->symbols = std::move(table);
+    next->completions = CompletionIndex(next->symbols.names());
+    next->references = ReferenceIndex::build(next->symbols, indexedFiles);
+    next->autoloader = autoloader;
+
+    // Readers that still hold the previous generation keep it alive until
+    // they drop their reference
+    std::atomic_store(&currentSnapshot, std::shared_ptr<const IndexSnapshot>(std::move(next)));
+}
+
+void SimpleSymbolIndexer::parseContent(IndexedFile &entry, const QByteArray &content)
+{
+    // Touched but unchanged (checkout, copy, build step): keep the old symbols
+    const QByteArray contentHash = QCryptographicHash::hash(content, QCryptographicHash::Md5);
+    if (contentHash == entry.contentHash) {
+        return;
+    }
+    entry.contentHash = contentHash;
+    PhpSymbolLexer lexer(content);
+    lexer.run();
+    entry.symbols = lexer.symbols();
+    lexer.encodeReferences(entry.referenceNames, entry.referenceLines);
+}
@@ -2,9 +2,19 @@
 #define INCODE_SIMPLESYMBOLINDEXER_H
 
 #include "ISymbolProvider.h"
-#include <QMap>
+#include "SymbolIndexCache.h"
+#include "IndexSnapshot.h"
+#include "ProjectScanner.h"
+#include <QHash>
+#include <QSet>
+#include <QVector>
 #include <QString>
 #include <QObject>
+#include <QStringList>
+#include <QAtomicInt>
+#include <memory>
+
+class QThreadPool;
 
 class SimpleSymbolIndexer : public QObject, public ISymbolProvider
 {
@@ -15,21 +25,92 @@ public:
     ~SimpleSymbolIndexer() override;
 
     SymbolLocation findSymbolLocation(const QString &symbolName) const override;
+    QList<SymbolLocation> findSymbolLocations(const QString &symbolName) const override;
+    // Safe to call from any thread. A file that isn't indexed yet is parsed
+    // for this lookup and then added to the index on the indexing thread.
+    SymbolLocation resolveClass(const QString &qualifiedName) override;
+    QList<SymbolLocation> findReferences(const QString &symbolName) const override;
     void indexDirectory(const QString &directoryPath) override; // Called from main thread
+    // Cancels any running job and indexes directoryPath, starting with
+    // priorityFiles (typically the files open in the editor)
+    void indexDirectory(const QString &directoryPath, const QStringList &priorityFiles);
+    // Stops the running job at the next file boundary. Safe from any thread.
+    void cancelIndexing();
     QStringList allSymbols() const override;
+    QStringList completeSymbol(const QString &prefix, int limit) const override;
+
+    // The current index generation. Safe to call from any thread: snapshots
+    // are immutable and replaced as a whole when indexing finishes.
+    std::shared_ptr<const IndexSnapshot> snapshot() const;
+
+    // Number of worker threads used by doIndexDirectory (defaults to one per core)
+    void setThreadCount(int count);
+    int threadCount() const;
+
+    // Whether .incode/symbols.idx is read and written (default on). Set it
+    // before indexing starts; benchmarks turn it off to parse everything.
+    void setCacheEnabled(bool enabled);
+    bool cacheEnabled() const;
+
+    // Adds work to every full indexing pass: the consumer is offered each
+    // project file and gets the bytes the indexer reads anyway, so it
+    // doesn't need a walk and read of its own. Call before indexing starts;
+    // open-file and incremental passes don't include consumers.
+    void addScanConsumer(const std::shared_ptr<ScanConsumer> &consumer);
+
+    // Parses one file's content into entry, unless its hash is unchanged.
+    // Only touches entry, so it runs concurrently for distinct entries.
+    static void parseContent(IndexedFile &entry, const QByteArray &content);
+
+    // Minimum time between two indexingProgress emissions
+    static constexpr int ProgressIntervalMsecs = 100;
 
 public slots:
-    void doIndexDirectory(const QString &directoryPath); // This will run in the thread
+    void doIndexDirectory(const QString &directoryPath, const QStringList &priorityFiles, int job); // This will run in the thread
+    // Re-indexes changed files and drops deleted ones from the current project
+    void doReindexFiles(const QStringList &filePaths);
+    // Indexes files outside the walk (resolved vendor classes) and keeps
+    // them in every later pass over the same project
+    void doIndexLazyFiles(const QStringList &filePaths);
 
 signals:
-    void startIndexing(const QString &directoryPath); // New signal to trigger work in worker thread
+    void startIndexing(const QString &directoryPath, const QStringList &priorityFiles, int job); // New signal to trigger work in worker thread
+    void startReindexing(const QStringList &filePaths);
+    void startLazyIndexing(const QStringList &filePaths);
     void indexingProgress(int progress);
     void indexingFinished();
+    // The last requested job was cancelled; not emitted when a newer job replaced it
+    void indexingCancelled();
 
 private:
-    void indexFile(const QString &filePath);
+    // Reads and parses entries[staleEntries[i]] on the pool, together with the
+    // scan consumers if asked. Returns false if the job was cancelled;
+    // entries that were not parsed then have an empty filePath.
+    bool parseEntries(QVector<IndexedFile> &entries, const QVector<int> &staleEntries, int job,
+                      bool reportProgress, bool withScanConsumers);
+    bool isCancelled(int job) const { return currentJob.loadAcquire() != job; }
+    // Ends a cancelled job, keeping what was parsed in the cache for the restart
+    void abandonJob(const QVector<IndexedFile> &entries, bool saveParsed);
+    void rebuildSymbolTable();
+    // Atomically replaces the generation seen by readers
+    void publish(SymbolTable table);
+
+    // Only ever accessed through std::atomic_load/atomic_store. indexedFiles
+    // and everything else below belongs to the indexing thread.
+    std::shared_ptr<const IndexSnapshot> currentSnapshot;
+    QHash<QString, IndexedFile> indexedFiles;
+    QString projectPath;
+    // Loaded at the start of each full pass and published with every snapshot
+    ComposerAutoloader autoloader;
+    QSet<QString> lazyFiles;
+    QThreadPool *workerPool;
+    bool useCache = true;
+    QVector<std::shared_ptr<ScanConsumer>> scanConsumers;
 
-    QMap<QString, SymbolLocation> symbolMap;
+    // Bumped for every requested job and on cancel; a job runs while it is current
+    QAtomicInt currentJob;
+    // Jobs requested but not yet finished or abandoned
+    QAtomicInt pendingJobs;
 };
 
 #endif // INCODE_SIMPLESYMBOLINDEXER_H
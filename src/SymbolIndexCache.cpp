@@ -0,0 +1,67 @@
+#include "SymbolIndexCache.h"
+#include <QDataStream>
+#include <QDir>
+
+namespace {
+const quint32 CacheMagic = 0x494E4358; // "INCX"
+const quint32 CacheVersion = 3;
+}
+
+SymbolIndexCache::SymbolIndexCache(const QString &projectPath)
+    : projectPath(projectPath), file(projectPath, "symbols.idx", CacheMagic, CacheVersion, "symbol cache")
+{
+}
+
+QString SymbolIndexCache::cacheFilePath() const
+{
+    return file.filePath();
+}
+
+bool SymbolIndexCache::load(QHash<QString, IndexedFile> &files) const
+{
+    files.clear();
+    const QDir root(projectPath);
+    const bool ok = file.read([&](QDataStream &in) {
+        quint32 fileCount = 0;
+        in >> fileCount;
+        files.reserve(fileCount);
+        for (quint32 i = 0; i < fileCount && in.status() == QDataStream::Ok; ++i) {
+            QByteArray relativePath;
+            quint32 symbolCount = 0;
+            IndexedFile entry;
+            in >> relativePath >> entry.modified >> entry.size >> entry.contentHash >> symbolCount;
+            entry.filePath = root.absoluteFilePath(QString::fromUtf8(relativePath));
+
+            for (quint32 j = 0; j < symbolCount && in.status() == QDataStream::Ok; ++j) {
+                QByteArray name;
+                qint32 lineNumber = 0;
+                quint8 kind = 0;
+                in >> name >> lineNumber >> kind;
+                entry.symbols.append(IndexedSymbol{QString::fromUtf8(name), lineNumber, SymbolKind(kind)});
+            }
+            in >> entry.referenceNames >> entry.referenceLines;
+            files.insert(entry.filePath, entry);
+        }
+    });
+    if (!ok) {
+        files.clear();
+    }
+    return ok;
+}
+
+bool SymbolIndexCache::save(const QHash<QString, IndexedFile> &files) const
+{
+    const QDir root(projectPath);
+    return file.write([&](QDataStream &out) {
+        out << quint32(files.size());
+        for (const IndexedFile &entry : files) {
+            out << root.relativeFilePath(entry.filePath).toUtf8()
+                << entry.modified << entry.size << entry.contentHash
+                << quint32(entry.symbols.size());
+            for (const IndexedSymbol &symbol : entry.symbols) {
+                out << symbol.name.toUtf8() << qint32(symbol.lineNumber) << quint8(symbol.kind);
+            }
+            out << entry.referenceNames << entry.referenceLines;
+        }
+    });
+}
@@ -0,0 +1,53 @@
+#ifndef INCODE_SYMBOLINDEXCACHE_H
+#define INCODE_SYMBOLINDEXCACHE_H
+
+#include "ISymbolProvider.h"
+#include "CacheFile.h"
+#include <QString>
+#include <QByteArray>
+#include <QList>
+#include <QHash>
+
+// A symbol definition found in a single file
+struct IndexedSymbol {
+    QString name;
+    int lineNumber;
+    SymbolKind kind;
+};
+
+// Everything the indexer knows about one file. The modification time and
+// size are a cheap first check; the content hash catches files that were
+// touched without being changed (e.g. by a branch switch).
+struct IndexedFile {
+    QString filePath;
+    qint64 modified = 0; // msecs since epoch
+    qint64 size = -1;
+    QByteArray contentHash;
+    QList<IndexedSymbol> symbols;
+    // Identifier occurrences, see PhpSymbolLexer::encodeReferences()
+    QByteArray referenceNames;
+    QByteArray referenceLines;
+};
+
+// Persists the per-file index to <project>/.incode/symbols.idx so that
+// reopening a project only has to re-parse new or changed files.
+class SymbolIndexCache
+{
+public:
+    explicit SymbolIndexCache(const QString &projectPath);
+
+    QString cacheFilePath() const;
+
+    // Reads a previously saved index (memory-mapped). Returns false and leaves
+    // files empty if there is no cache or it was written by another version.
+    bool load(QHash<QString, IndexedFile> &files) const;
+
+    // Atomically replaces the cache file with the given entries
+    bool save(const QHash<QString, IndexedFile> &files) const;
+
+private:
+    QString projectPath;
+    CacheFile file;
+};
+
+#endif // INCODE_SYMBOLINDEXCACHE_H
@@ -0,0 +1,135 @@
+#include "SymbolTable.h"
+#include <algorithm>
+#include <cstring>
+
+namespace {
+
+// Byte-wise ordering shared by sorting and lookup
+int compareUtf8(const char *a, int aLength, const char *b, int bLength)
+{
+    const int common = qMin(aLength, bLength);
+    const int result = common > 0 ? std::memcmp(a, b, size_t(common)) : 0;
+    if (result != 0)
+        return result;
+    return aLength - bLength;
+}
+
+struct PendingSymbol {
+    QByteArray name;
+    SymbolTable::Record record;
+};
+
+} // namespace
+
+SymbolTable SymbolTable::fromFiles(const QHash<QString, IndexedFile> &files)
+{
+    SymbolTable table;
+    table.filePaths = files.keys();
+    table.filePaths.sort();
+
+    QVector<PendingSymbol> pending;
+    for (int fileId = 0; fileId < table.filePaths.size(); ++fileId) {
+        const IndexedFile &entry = *files.constFind(table.filePaths.at(fileId));
+        for (const IndexedSymbol &symbol : entry.symbols) {
+            Record record;
+            record.fileId = quint32(fileId);
+            record.lineNumber = quint32(qMax(0, symbol.lineNumber));
+            record.kind = quint32(symbol.kind);
+            pending.append(PendingSymbol{symbol.name.toUtf8(), record});
+        }
+    }
+
+    // Group by name; within a name, class-like definitions come first
+    std::sort(pending.begin(), pending.end(), [](const PendingSymbol &a, const PendingSymbol &b) {
+        const int byName = compareUtf8(a.name.constData(), a.name.size(), b.name.constData(), b.name.size());
+        if (byName != 0)
+            return byName < 0;
+        if (a.record.kind != b.record.kind)
+            return a.record.kind < b.record.kind;
+        if (a.record.fileId != b.record.fileId)
+            return a.record.fileId < b.record.fileId;
+        return a.record.lineNumber < b.record.lineNumber;
+    });
+
+    table.records.reserve(pending.size());
+    for (int i = 0; i < pending.size(); ++i) {
+        if (i == 0 || pending.at(i).name != pending.at(i - 1).name) {
+            table.nameOffsets.append(quint32(table.nameArena.size()));
+            table.recordOffsets.append(quint32(table.records.size()));
+            table.nameArena.append(pending.at(i).name);
+        }
+        table.records.append(pending.at(i).record);
+    }
+    table.nameOffsets.append(quint32(table.nameArena.size()));
+    table.recordOffsets.append(quint32(table.records.size()));
+
+    table.nameArena.squeeze();
+    table.nameOffsets.squeeze();
+    table.recordOffsets.squeeze();
+    return table;
+}
+
+QList<SymbolLocation> SymbolTable::find(const QString &name) const
+{
+    QList<SymbolLocation> locations;
+    const int id = nameId(name);
+    if (id < 0)
+        return locations;
+
+    const quint32 first = recordOffsets.at(id);
+    const quint32 last = recordOffsets.at(id + 1);
+    locations.reserve(int(last - first));
+    for (quint32 i = first; i < last; ++i) {
+        const Record &record = records.at(int(i));
+        locations.append(SymbolLocation{filePaths.at(int(record.fileId)), int(record.lineNumber), SymbolKind(record.kind)});
+    }
+    return locations;
+}
+
+QStringList SymbolTable::names() const
+{
+    QStringList result;
+    const int count = nameCount();
+    result.reserve(count);
+    for (int i = 0; i < count; ++i) {
+        result.append(nameAt(i));
+    }
+    return result;
+}
+
+qsizetype SymbolTable::memoryUsage() const
+{
+    qsizetype bytes = nameArena.capacity()
+                      + nameOffsets.capacity() * qsizetype(sizeof(quint32))
+                      + recordOffsets.capacity() * qsizetype(sizeof(quint32))
+                      + records.capacity() * qsizetype(sizeof(Record));
+    for (const QString &path : filePaths) {
+        bytes += qsizetype(sizeof(QString)) + path.capacity() * qsizetype(sizeof(QChar));
+    }
+    return bytes;
+}
+
+int SymbolTable::nameId(const QByteArray &utf8) const
+{
+    int low = 0;
+    int high = nameCount();
+    while (low < high) {
+        const int middle = low + (high - low) / 2;
+        const quint32 offset = nameOffsets.at(middle);
+        const int length = int(nameOffsets.at(middle + 1) - offset);
+        const int order = compareUtf8(nameArena.constData() + offset, length, utf8.constData(), utf8.size());
+        if (order == 0)
+            return middle;
+        if (order < 0)
+            low = middle + 1;
+        else
+            high = middle;
+    }
+    return -1;
+}
+
+QString SymbolTable::nameAt(int id) const
+{
+    const quint32 offset = nameOffsets.at(id);
+    return QString::fromUtf8(nameArena.constData() + offset, int(nameOffsets.at(id + 1) - offset));
+}
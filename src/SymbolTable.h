@@ -0,0 +1,68 @@
+#ifndef INCODE_SYMBOLTABLE_H
+#define INCODE_SYMBOLTABLE_H
+
+#include "ISymbolProvider.h"
+#include "SymbolIndexCache.h"
+#include <QByteArray>
+#include <QHash>
+#include <QList>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+
+// Compact, read-only symbol store holding every definition of every name.
+//
+// Layout: file paths are interned once (fileId -> path). Distinct names are
+// stored sorted in a single UTF-8 arena; name i spans
+// nameArena[nameOffsets[i], nameOffsets[i + 1]). The definitions of name i
+// are records[recordOffsets[i], recordOffsets[i + 1]), 8 bytes each, ordered
+// class-like kinds first, then by file and line.
+//
+// For 1M symbols with 250k distinct names (14 bytes on average) that is
+// 8 MB of records, 3.5 MB of arena and 2 MB of offsets, plus one QString per
+// file: about 20 bytes per symbol. The QMap<QString, SymbolLocation> it
+// replaces needed a map node, a key QString and a value QString per name,
+// roughly 130 bytes, and kept only one definition per name.
+class SymbolTable
+{
+public:
+    struct Record {
+        quint32 fileId;
+        quint32 lineNumber : 28;
+        quint32 kind : 4;
+    };
+
+    SymbolTable() = default;
+
+    // Builds the table from the indexer's per-file entries
+    static SymbolTable fromFiles(const QHash<QString, IndexedFile> &files);
+
+    // All definitions of a name, best candidate first; empty if unknown
+    QList<SymbolLocation> find(const QString &name) const;
+
+    // Distinct names in sorted (UTF-8 byte) order
+    QStringList names() const;
+
+    int nameCount() const { return nameOffsets.isEmpty() ? 0 : nameOffsets.size() - 1; }
+    int symbolCount() const { return records.size(); }
+    int fileCount() const { return filePaths.size(); }
+    QString filePath(int fileId) const { return filePaths.at(fileId); }
+
+    // Position of a name in the sorted name list, or -1
+    int nameId(const QByteArray &utf8) const;
+    int nameId(const QString &name) const { return nameId(name.toUtf8()); }
+
+    // Approximate heap bytes held by the table
+    qsizetype memoryUsage() const;
+
+private:
+    QString nameAt(int id) const;
+
+    QStringList filePaths;
+    QByteArray nameArena;
+    QVector<quint32> nameOffsets;
+    QVector<quint32> recordOffsets;
+    QVector<Record> records;
+};
+
+#endif // INCODE_SYMBOLTABLE_H
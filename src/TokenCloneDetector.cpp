@@ -0,0 +1,658 @@
+#include "TokenCloneDetector.h"
+#include <algorithm>
+#include <climits>
+#include <cstdlib>
+#include <cstring>
+
+namespace {
+
+enum : quint32 {
+    SeparatorToken = 0,
+    IdentifierToken = 1,
+    VariableToken = 2,
+    LiteralToken = 3
+};
+
+// Names that keep their own token; every other name is an IdentifierToken.
+// Sorted, compared in lower case.
+const char *const Keywords[] = {
+    "abstract", "and", "array", "as", "break", "callable", "case", "catch", "class", "clone",
+    "const", "continue", "declare", "default", "do", "echo", "else", "elseif", "empty",
+    "enddeclare", "endfor", "endforeach", "endif", "endswitch", "endwhile", "enum", "extends",
+    "final", "finally", "fn", "for", "foreach", "function", "global", "goto", "if", "implements",
+    "include", "include_once", "instanceof", "insteadof", "interface", "isset", "list", "match",
+    "namespace", "new", "or", "parent", "print", "private", "protected", "public", "readonly",
+    "require", "require_once", "return", "self", "static", "switch", "throw", "trait", "try",
+    "unset", "use", "var", "while", "xor", "yield"
+};
+
+// Longest operators first
+const char *const Operators[] = {
+    "<<=", ">>=", "**=", "?\?=", "...", "===", "!==", "<=>", "?->",
+    "==", "!=", "<>", "<=", ">=", "&&", "||", "++", "--", "+=", "-=", "*=", "/=", ".=", "%=",
+    "&=", "|=", "^=", "->", "=>", "::", "<<", ">>", "??", "**"
+};
+
+bool isSpace(char c)
+{
+    return c == ' ' || c == '\t' || c == '\r' || c == '\v' || c == '\f';
+}
+
+bool isIdentifierStart(char c)
+{
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_' || static_cast<unsigned char>(c) >= 0x80;
+}
+
+bool isIdentifierChar(char c)
+{
+    return isIdentifierStart(c) || (c >= '0' && c <= '9');
+}
+
+bool startsWith(const char *pos, const char *end, const char *text)
+{
+    const size_t length = std::strlen(text);
+    return size_t(end - pos) >= length && std::memcmp(pos, text, length) == 0;
+}
+
+// Code of a keyword or operator token; the top bit keeps it apart from the
+// abstract token kinds
+quint32 textCode(const char *begin, const char *end)
+{
+    quint32 hash = 2166136261u;
+    for (const char *pos = begin; pos < end; ++pos) {
+        hash ^= static_cast<unsigned char>(*pos);
+        hash *= 16777619u;
+    }
+    return hash | 0x80000000u;
+}
+
+// FNV-1a over a run of token codes
+quint64 sequenceHash(const quint32 *begin, const quint32 *end)
+{
+    quint64 hash = 14695981039346656037ull;
+    for (const quint32 *pos = begin; pos < end; ++pos) {
+        hash ^= *pos;
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+int countNewlines(const char *begin, const char *end)
+{
+    return int(std::count(begin, end, '\n'));
+}
+
+// Skips a heredoc/nowdoc starting at "<<<"; returns the position after the
+// closing label, or end
+const char *skipHeredoc(const char *pos, const char *end)
+{
+    pos += 3;
+    while (pos < end && isSpace(*pos))
+        ++pos;
+    const char quote = (pos < end && (*pos == '\'' || *pos == '"')) ? *pos : 0;
+    if (quote)
+        ++pos;
+    const char *label = pos;
+    while (pos < end && isIdentifierChar(*pos))
+        ++pos;
+    const size_t labelLength = size_t(pos - label);
+    if (labelLength == 0)
+        return pos;
+
+    // The closing label starts a line (after optional indentation) and is
+    // not followed by another identifier character
+    const char *lineStart = static_cast<const char *>(std::memchr(pos, '\n', size_t(end - pos)));
+    while (lineStart) {
+        const char *cursor = lineStart + 1;
+        while (cursor < end && isSpace(*cursor))
+            ++cursor;
+        if (size_t(end - cursor) >= labelLength && std::memcmp(cursor, label, labelLength) == 0
+            && (cursor + labelLength == end || !isIdentifierChar(cursor[labelLength]))) {
+            return cursor + labelLength;
+        }
+        lineStart = static_cast<const char *>(std::memchr(cursor, '\n', size_t(end - cursor)));
+    }
+    return end;
+}
+
+// Leading tokens of an lcp-interval searched for a period; longer periods
+// are only caught when neighbouring suffixes overlap
+const int PeriodPrefixTokens = 256;
+
+// Which tokens earlier clone classes took. Counting the claimed tokens of
+// a range is a prefix sum over a Fenwick tree, and claiming skips tokens
+// that are already taken, so every token is added once in all.
+class ClaimedTokens
+{
+public:
+    explicit ClaimedTokens(int count) : tree(count + 1, 0), next(count + 1)
+    {
+        for (int i = 0; i <= count; ++i) {
+            next[i] = i;
+        }
+    }
+
+    // Claimed tokens in [begin, end)
+    int count(int begin, int end) const { return prefix(end) - prefix(begin); }
+
+    void claim(int begin, int end)
+    {
+        for (int i = unclaimed(begin); i < end; i = unclaimed(i + 1)) {
+            for (int j = i + 1; j < tree.size(); j += j & -j) {
+                ++tree[j];
+            }
+            next[i] = i + 1;
+        }
+    }
+
+private:
+    int prefix(int end) const
+    {
+        int sum = 0;
+        for (int j = end; j > 0; j -= j & -j) {
+            sum += tree.at(j);
+        }
+        return sum;
+    }
+
+    // First unclaimed token at or after i, halving the path on the way
+    int unclaimed(int i)
+    {
+        while (next.at(i) != i) {
+            next[i] = next.at(next.at(i));
+            i = next.at(i);
+        }
+        return i;
+    }
+
+    QVector<int> tree;
+    QVector<int> next; // next[i] == i while token i is unclaimed; the last is a sentinel
+};
+
+} // namespace
+
+TokenCloneDetector::FileTokens TokenCloneDetector::tokenize(const QByteArray &content)
+{
+    FileTokens file;
+    const char *pos = content.constData();
+    const char *end = pos + content.size();
+    int line = 1;
+    bool inPhp = false;
+    // use and namespace statements are boilerplate shared by most files;
+    // they are dropped like the old line filter did
+    bool statementStart = true;
+    bool skipStatement = false;
+
+    auto push = [&file, &skipStatement](quint32 code, int tokenLine) {
+        if (!skipStatement) {
+            file.tokens.append(code);
+            file.lines.append(tokenLine);
+        }
+    };
+
+    while (pos < end) {
+        if (!inPhp) {
+            const char *open = pos;
+            while ((open = static_cast<const char *>(std::memchr(open, '<', size_t(end - open))))) {
+                if (open + 1 < end && open[1] == '?')
+                    break;
+                ++open;
+            }
+            if (!open)
+                break;
+            line += countNewlines(pos, open);
+            pos = open + 2;
+            if (end - pos >= 3 && (pos[0] | 0x20) == 'p' && (pos[1] | 0x20) == 'h' && (pos[2] | 0x20) == 'p')
+                pos += 3;
+            else if (pos < end && *pos == '=')
+                ++pos;
+            inPhp = true;
+            statementStart = true;
+            skipStatement = false;
+            continue;
+        }
+
+        const char c = *pos;
+        if (c == '\n') {
+            ++line;
+            ++pos;
+            continue;
+        }
+        if (isSpace(c)) {
+            ++pos;
+            continue;
+        }
+        if ((c == '#' && !(pos + 1 < end && pos[1] == '[')) || (c == '/' && pos + 1 < end && pos[1] == '/')) {
+            // Line comments also end at a closing tag
+            while (pos < end && *pos != '\n' && !(*pos == '?' && pos + 1 < end && pos[1] == '>'))
+                ++pos;
+            continue;
+        }
+        if (c == '/' && pos + 1 < end && pos[1] == '*') {
+            const char *close = pos + 2;
+            while (close + 1 < end && !(close[0] == '*' && close[1] == '/'))
+                ++close;
+            const char *stop = close + 1 < end ? close + 2 : end;
+            line += countNewlines(pos, stop);
+            pos = stop;
+            continue;
+        }
+        if (c == '?' && pos + 1 < end && pos[1] == '>') {
+            pos += 2;
+            inPhp = false;
+            continue;
+        }
+
+        const int tokenLine = line;
+        const char *start = pos;
+
+        if (c == '$' && pos + 1 < end && isIdentifierStart(pos[1])) {
+            pos += 2;
+            while (pos < end && isIdentifierChar(*pos))
+                ++pos;
+            push(VariableToken, tokenLine);
+            statementStart = false;
+            continue;
+        }
+
+        if (isIdentifierStart(c) || (c == '\\' && pos + 1 < end && isIdentifierStart(pos[1]))) {
+            while (pos < end && (isIdentifierChar(*pos) || *pos == '\\'))
+                ++pos;
+            char word[16];
+            const size_t length = size_t(pos - start);
+            quint32 code = IdentifierToken;
+            if (length < sizeof(word)) {
+                for (size_t i = 0; i < length; ++i) {
+                    word[i] = (start[i] >= 'A' && start[i] <= 'Z') ? char(start[i] | 0x20) : start[i];
+                }
+                word[length] = '\0';
+                if (!std::strcmp(word, "true") || !std::strcmp(word, "false") || !std::strcmp(word, "null")) {
+                    code = LiteralToken;
+                } else if (std::binary_search(std::begin(Keywords), std::end(Keywords), word,
+                                              [](const char *a, const char *b) { return std::strcmp(a, b) < 0; })) {
+                    code = textCode(word, word + length);
+                    if (statementStart && (!std::strcmp(word, "use") || !std::strcmp(word, "namespace")))
+                        skipStatement = true;
+                }
+            }
+            push(code, tokenLine);
+            statementStart = false;
+            continue;
+        }
+
+        if ((c >= '0' && c <= '9') || (c == '.' && pos + 1 < end && pos[1] >= '0' && pos[1] <= '9')) {
+            ++pos;
+            while (pos < end) {
+                if (isIdentifierChar(*pos) || *pos == '.') {
+                    ++pos;
+                } else if ((*pos == '+' || *pos == '-') && (pos[-1] == 'e' || pos[-1] == 'E')
+                           && !(start + 1 < end && start[0] == '0' && (start[1] | 0x20) == 'x')) {
+                    ++pos; // exponent sign
+                } else {
+                    break;
+                }
+            }
+            push(LiteralToken, tokenLine);
+            statementStart = false;
+            continue;
+        }
+
+        if (c == '\'' || c == '"' || c == '`') {
+            ++pos;
+            while (pos < end && *pos != c) {
+                if (*pos == '\\' && pos + 1 < end)
+                    ++pos;
+                ++pos;
+            }
+            if (pos < end)
+                ++pos;
+            line += countNewlines(start, pos);
+            push(LiteralToken, tokenLine);
+            statementStart = false;
+            continue;
+        }
+
+        if (startsWith(pos, end, "<<<")) {
+            pos = skipHeredoc(pos, end);
+            line += countNewlines(start, pos);
+            push(LiteralToken, tokenLine);
+            statementStart = false;
+            continue;
+        }
+
+        size_t length = 1;
+        for (const char *op : Operators) {
+            if (startsWith(pos, end, op)) {
+                length = std::strlen(op);
+                break;
+            }
+        }
+        pos += length;
+
+        // A namespace block's header ends at its brace, which is kept so
+        // braces stay balanced
+        if (skipStatement && (c == ';' || c == '{')) {
+            skipStatement = false;
+            if (c == ';') {
+                statementStart = true;
+                continue;
+            }
+        }
+        push(textCode(start, pos), tokenLine);
+        statementStart = length == 1 && (c == ';' || c == '{' || c == '}');
+    }
+    return file;
+}
+
+quint32 TokenCloneDetector::textToken(const char *text)
+{
+    return textCode(text, text + std::strlen(text));
+}
+
+void TokenCloneDetector::addFile(const FileTokens &file)
+{
+    fileStarts.append(stream.size());
+    stream.append(file.tokens);
+    lines.append(file.lines);
+    stream.append(SeparatorToken);
+    lines.append(file.lines.isEmpty() ? 0 : file.lines.last());
+}
+
+void TokenCloneDetector::clear()
+{
+    stream = QVector<quint32>();
+    lines = QVector<int>();
+    fileStarts = QVector<int>();
+}
+
+QVector<TokenCloneDetector::CloneClass> TokenCloneDetector::detect(int minTokens, const Callback &callback,
+                                                                    const FoundCallback &found) const
+{
+    QVector<CloneClass> classes;
+    const int n = stream.size();
+    auto keepGoing = [&](int progress) {
+        return !callback || callback(progress);
+    };
+    if (n == 0 || minTokens < 1)
+        return classes;
+
+    // Dense symbols: token codes by value, then one symbol per separator
+    QVector<quint32> codes;
+    codes.reserve(n);
+    for (quint32 code : stream) {
+        if (code != SeparatorToken)
+            codes.append(code);
+    }
+    std::sort(codes.begin(), codes.end());
+    codes.erase(std::unique(codes.begin(), codes.end()), codes.end());
+    QVector<int> symbols(n);
+    int alphabet = codes.size();
+    for (int i = 0; i < n; ++i) {
+        symbols[i] = stream.at(i) == SeparatorToken
+                         ? alphabet++
+                         : int(std::lower_bound(codes.begin(), codes.end(), stream.at(i)) - codes.begin());
+    }
+    codes = QVector<quint32>();
+    if (!keepGoing(10))
+        return classes;
+
+    // Suffix array by prefix doubling with radix sorts: after the round for
+    // k, suffixes are sorted by their first 2k symbols
+    QVector<int> sa(n);
+    QVector<int> rank(symbols);
+    QVector<int> order(n);
+    QVector<int> counts(qMax(alphabet, n) + 1, 0);
+    for (int i = 0; i < n; ++i) {
+        ++counts[rank.at(i)];
+    }
+    for (int r = 1; r < alphabet; ++r) {
+        counts[r] += counts.at(r - 1);
+    }
+    for (int i = n - 1; i >= 0; --i) {
+        sa[--counts[rank.at(i)]] = i;
+    }
+
+    int distinct = alphabet;
+    int round = 0;
+    for (int k = 1; distinct < n; k <<= 1, ++round) {
+        // Order by the second half: suffixes without one first, then the rest
+        // in the current suffix order
+        int filled = 0;
+        for (int i = n - k; i < n; ++i) {
+            order[filled++] = i;
+        }
+        for (int i = 0; i < n; ++i) {
+            if (sa.at(i) >= k)
+                order[filled++] = sa.at(i) - k;
+        }
+        // Stable counting sort by the first half
+        std::fill(counts.begin(), counts.begin() + distinct + 1, 0);
+        for (int i = 0; i < n; ++i) {
+            ++counts[rank.at(i)];
+        }
+        for (int r = 1; r < distinct; ++r) {
+            counts[r] += counts.at(r - 1);
+        }
+        for (int i = n - 1; i >= 0; --i) {
+            sa[--counts[rank.at(order.at(i))]] = order.at(i);
+        }
+        // New ranks, reusing order as scratch
+        order[sa.at(0)] = 0;
+        distinct = 1;
+        for (int i = 1; i < n; ++i) {
+            const int a = sa.at(i - 1);
+            const int b = sa.at(i);
+            const int secondA = a + k < n ? rank.at(a + k) : -1;
+            const int secondB = b + k < n ? rank.at(b + k) : -1;
+            if (rank.at(a) != rank.at(b) || secondA != secondB)
+                ++distinct;
+            order[b] = distinct - 1;
+        }
+        rank.swap(order);
+        if (!keepGoing(qMin(80, 10 + 10 * (round + 1))))
+            return classes;
+    }
+    order = QVector<int>();
+    counts = QVector<int>();
+
+    // LCP of neighbouring suffixes (Kasai); rank is the inverse of sa here
+    QVector<int> lcp(n, 0);
+    for (int i = 0, h = 0; i < n; ++i) {
+        if (rank.at(i) == 0) {
+            h = 0;
+            continue;
+        }
+        const int j = sa.at(rank.at(i) - 1);
+        while (i + h < n && j + h < n && symbols.at(i + h) == symbols.at(j + h))
+            ++h;
+        lcp[rank.at(i)] = h;
+        if (h > 0)
+            --h;
+    }
+    if (!keepGoing(85))
+        return classes;
+
+    // Candidate classes as sorted token offsets; occurrences that overlap
+    // the previous one of the same class are dropped
+    struct Candidate {
+        int length;
+        QVector<int> starts;
+    };
+    QVector<Candidate> candidates;
+    auto cloneOf = [this](const Candidate &candidate) {
+        const quint32 *first = stream.constData() + candidate.starts.first();
+        CloneClass clone{candidate.length, sequenceHash(first, first + candidate.length), {}};
+        for (int start : candidate.starts) {
+            const int fileIndex = int(std::upper_bound(fileStarts.begin(), fileStarts.end(), start) - fileStarts.begin()) - 1;
+            clone.occurrences.append(CloneOccurrence{fileIndex, lines.at(start), lines.at(start + candidate.length - 1)});
+        }
+        return clone;
+    };
+    auto addCandidate = [&](int length, int first, int last) {
+        QVector<int> starts;
+        starts.reserve(last - first + 1);
+        for (int i = first; i <= last; ++i) {
+            starts.append(sa.at(i));
+        }
+        std::sort(starts.begin(), starts.end());
+        Candidate candidate{length, {}};
+        int covered = -1;
+        for (int start : std::as_const(starts)) {
+            if (start >= covered) {
+                candidate.starts.append(start);
+                covered = start + length;
+            }
+        }
+        if (candidate.starts.size() >= 2) {
+            if (found)
+                found(cloneOf(candidate));
+            candidates.append(candidate);
+        }
+    };
+
+    // Bottom-up walk over the lcp-intervals. Each interval tracks whether
+    // its suffixes are preceded by different symbols (left-diverse); only
+    // those are maximal, the others are a one-token shift of a longer clone.
+    struct Interval {
+        int lcp;
+        int first;
+        int left; // common preceding symbol, -1 if none seen yet
+        bool diverse;
+        int minGap; // least distance between the starts of neighbouring suffixes
+    };
+    auto addLeft = [](Interval &interval, int symbol) {
+        if (interval.diverse)
+            return;
+        if (interval.left < 0)
+            interval.left = symbol;
+        else if (interval.left != symbol)
+            interval.diverse = true;
+    };
+    auto adopt = [&addLeft](Interval &parent, const Interval &child) {
+        parent.minGap = qMin(parent.minGap, child.minGap);
+        if (child.diverse)
+            parent.diverse = true;
+        else if (child.left >= 0)
+            addLeft(parent, child.left);
+    };
+
+    // Periodic code (a long config or seeder array is one statement over
+    // and over once normalized) has a left-diverse interval for every
+    // number of repetitions, each holding up to all suffixes of the run.
+    // Those intervals have occurrences that overlap, and are dropped before
+    // their suffixes are copied: when two neighbouring suffixes overlap, or
+    // when the smallest period of the leading tokens leads from the suffix
+    // at either end of the interval to another one in it.
+    QVector<int> failure(PeriodPrefixTokens);
+    auto overlaps = [&](const Interval &interval, int last) {
+        if (interval.minGap < interval.lcp)
+            return true;
+        const int *tokens = symbols.constData() + sa.at(interval.first);
+        const int length = qMin(interval.lcp, PeriodPrefixTokens);
+        failure[0] = 0;
+        for (int i = 1, k = 0; i < length; ++i) {
+            while (k > 0 && tokens[i] != tokens[k])
+                k = failure.at(k - 1);
+            if (tokens[i] == tokens[k])
+                ++k;
+            failure[i] = k;
+        }
+        const int period = length - failure.at(length - 1);
+        if (period >= interval.lcp)
+            return false;
+        for (const int end : {interval.first, last}) {
+            const int shifted = sa.at(end) + period;
+            if (shifted < n && rank.at(shifted) >= interval.first && rank.at(shifted) <= last)
+                return true;
+        }
+        return false;
+    };
+
+    QVector<Interval> stack;
+    stack.append(Interval{0, 0, -1, false, INT_MAX});
+    for (int i = 1; i <= n; ++i) {
+        const int current = i < n ? lcp.at(i) : -1;
+        const int previous = sa.at(i - 1);
+        // The start of the stream counts as a symbol of its own
+        const int leftSymbol = previous > 0 ? symbols.at(previous - 1) : alphabet;
+        // The pair i - 1, i belongs to the interval whose lcp is current
+        const int gap = i < n ? std::abs(sa.at(i) - previous) : INT_MAX;
+
+        // The suffix at i - 1 belongs to the deeper of the intervals around
+        // it: a new one starting here, or the one on top of the stack
+        if (current > stack.last().lcp) {
+            stack.append(Interval{current, i - 1, leftSymbol, false, gap});
+            continue;
+        }
+        addLeft(stack.last(), leftSymbol);
+
+        int first = i - 1;
+        bool hasChild = false;
+        Interval child{};
+        while (!stack.isEmpty() && current < stack.last().lcp) {
+            const Interval closed = stack.takeLast();
+            if (closed.diverse && closed.lcp >= minTokens && !overlaps(closed, i - 1))
+                addCandidate(closed.lcp, closed.first, i - 1);
+            first = closed.first;
+            if (!stack.isEmpty() && current <= stack.last().lcp) {
+                adopt(stack.last(), closed);
+            } else {
+                child = closed;
+                hasChild = true;
+            }
+        }
+        if (i < n && current > stack.last().lcp) {
+            Interval opened{current, first, -1, false, INT_MAX};
+            if (hasChild)
+                adopt(opened, child);
+            stack.append(opened);
+        }
+        if (i < n)
+            stack.last().minGap = qMin(stack.last().minGap, gap);
+        if ((i & 0xffff) == 0 && !keepGoing(85 + int(qint64(i) * 14 / n)))
+            return classes;
+    }
+
+    sa = QVector<int>();
+    lcp = QVector<int>();
+    rank = QVector<int>();
+
+    // Longest first, each class claims its tokens. A class is kept only if
+    // one of its occurrences is mostly unclaimed: periodic code (runs of
+    // statements that are equal once normalized) otherwise yields a class
+    // for every shifted alignment of the same region.
+    std::sort(candidates.begin(), candidates.end(), [](const Candidate &a, const Candidate &b) {
+        if (a.length != b.length)
+            return a.length > b.length;
+        return a.starts.first() < b.starts.first();
+    });
+    ClaimedTokens claimed(n);
+    for (const Candidate &candidate : std::as_const(candidates)) {
+        bool novel = false;
+        for (int start : candidate.starts) {
+            if (claimed.count(start, start + candidate.length) * 2 < candidate.length) {
+                novel = true;
+                break;
+            }
+        }
+        if (!novel)
+            continue;
+
+        for (int start : candidate.starts) {
+            claimed.claim(start, start + candidate.length);
+        }
+        classes.append(cloneOf(candidate));
+    }
+
+    std::sort(classes.begin(), classes.end(), [](const CloneClass &a, const CloneClass &b) {
+        const CloneOccurrence &x = a.occurrences.first();
+        const CloneOccurrence &y = b.occurrences.first();
+        if (x.fileIndex != y.fileIndex)
+            return x.fileIndex < y.fileIndex;
+        if (x.startLine != y.startLine)
+            return x.startLine < y.startLine;
+        return a.tokenCount > b.tokenCount;
+    });
+    keepGoing(100);
+    return classes;
+}
@@ -0,0 +1,69 @@
+#ifndef INCODE_TOKENCLONEDETECTOR_H
+#define INCODE_TOKENCLONEDETECTOR_H
+
+#include <QByteArray>
+#include <QVector>
+#include <functional>
+
+// Finds duplicated token sequences across a set of PHP files.
+//
+// Files are reduced to normalized token streams: identifiers, variables and
+// literals each collapse to one token kind, so renamed copies (Type-2
+// clones) match as well as exact ones. All streams are concatenated with a
+// unique separator after each file, and clones are read off the suffix
+// array and its LCP array. Every lcp-interval of at least minTokens whose
+// occurrences are preceded by different tokens is one maximal clone class,
+// so a duplicated block is reported once, at its full length.
+class TokenCloneDetector
+{
+public:
+    struct FileTokens {
+        QVector<quint32> tokens; // normalized token codes
+        QVector<int> lines;      // 1-based line of every token
+    };
+
+    struct CloneOccurrence {
+        int fileIndex;
+        int startLine;
+        int endLine;
+    };
+
+    struct CloneClass {
+        int tokenCount;
+        quint64 hash; // of the normalized tokens; stable across runs
+        QVector<CloneOccurrence> occurrences; // in file and line order
+    };
+
+    // Called with the progress of detect() (0-100); returning false stops it
+    using Callback = std::function<bool(int progress)>;
+    // Called with each candidate class as the walk over the LCP intervals
+    // finds it. The final list drops some of them (shifted copies of the
+    // same periodic code) and is ordered differently.
+    using FoundCallback = std::function<void(const CloneClass &clone)>;
+
+    // Normalized tokens of one PHP file. Thread-safe.
+    static FileTokens tokenize(const QByteArray &content);
+    // Code tokenize() gives a keyword (in lower case) or operator
+    static quint32 textToken(const char *text);
+
+    // Appends the next file; its index is the number of files added before
+    void addFile(const FileTokens &file);
+    void clear();
+
+    int fileCount() const { return fileStarts.size(); }
+    int tokenCount() const { return stream.size() - fileStarts.size(); }
+
+    // Clone classes ordered by their first occurrence. Occurrences that
+    // overlap another one of the same class are dropped.
+    QVector<CloneClass> detect(int minTokens, const Callback &callback = Callback(),
+                               const FoundCallback &found = FoundCallback()) const;
+
+private:
+    // Token codes of all files, each file followed by a separator (code 0).
+    // detect() ranks every separator differently, so no match crosses one.
+    QVector<quint32> stream;
+    QVector<int> lines;
+    QVector<int> fileStarts; // stream offset of each file's first token
+};
+
+#endif // INCODE_TOKENCLONEDETECTOR_H
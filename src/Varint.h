@@ -0,0 +1,33 @@
+#ifndef INCODE_VARINT_H
+#define INCODE_VARINT_H
+
+#include <QByteArray>
+
+// LEB128-style variable-length integers used by the compressed reference
+// lists: 7 bits per byte, high bit set on every byte but the last.
+
+inline void appendVarint(QByteArray &out, quint32 value)
+{
+    while (value >= 0x80) {
+        out.append(char((value & 0x7F) | 0x80));
+        value >>= 7;
+    }
+    out.append(char(value));
+}
+
+// Reads one value and advances pos; returns 0 at (or past) end
+inline quint32 readVarint(const char *&pos, const char *end)
+{
+    quint32 value = 0;
+    int shift = 0;
+    while (pos < end && shift < 32) {
+        const uchar byte = uchar(*pos++);
+        value |= quint32(byte & 0x7F) << shift;
+        if (!(byte & 0x80))
+            break;
+        shift += 7;
+    }
+    return value;
+}
+
+#endif // INCODE_VARINT_H
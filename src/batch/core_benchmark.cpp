@@ -0,0 +1,481 @@
+// incode-core-bench: times the indexing and analysis building blocks on
+// generated input of a chosen size and prints the results as JSON, so
+// performance figures can be checked against the code that is in the
+// tree. Runs without a display.
+
+#include "CodeAnalyzer.h"
+#include "CompletionIndex.h"
+#include "NearDuplicateDetector.h"
+#include "PhpSymbolLexer.h"
+#include "TokenCloneDetector.h"
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QCryptographicHash>
+#include <QElapsedTimer>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QMap>
+#include <QRandomGenerator>
+#include <QRegularExpression>
+#include <QTextStream>
+#include <QVector>
+#include <algorithm>
+
+namespace {
+
+const char *const Verbs[] = {"get", "set", "find", "create", "update", "delete", "load", "save",
+                             "build", "parse", "render", "handle", "resolve", "validate", "dispatch"};
+const char *const Nouns[] = {"User", "Order", "Invoice", "Product", "Customer", "Payment", "Session",
+                             "Request", "Response", "Route", "Query", "Cache", "Event", "Listener",
+                             "Policy", "Token", "Account", "Address", "Report", "Message"};
+const char *const Suffixes[] = {"", "Name", "Id", "List", "Count", "Status", "Data", "Items", "ById", "ForUser"};
+const char *const Roles[] = {"Controller", "Service", "Repository"};
+
+// One-line PHP statements of different shapes; %1-%3 are variable names,
+// %4 is a method name and %5 a number
+const char *const Statements[] = {
+    "$%1 = $this->%4($%2, %5);",
+    "$%1 = $%2 + $%3 * %5;",
+    "if ($%1 > %5) { $%2 = $%1 - %5; }",
+    "foreach ($%1 as $%2) { $%3[] = $%2->%4(); }",
+    "$%1 = array_map(fn($item) => $item * %5, $%2);",
+    "$%1 = isset($%2['%4']) ? $%2['%4'] : null;",
+    "$this->%4 = new %4Service($%1, $%2);",
+    "while ($%1 < %5) { $%1 += $%2; }",
+    "$%1 = sprintf('%4-%s', $%2);",
+    "try { $%1 = $this->%4->find($%2); } catch (Exception $e) { return null; }",
+    "$%1 = $%2 === null ? %5 : count($%3);",
+    "static::%4($%1, [$%2, $%3]);",
+    "$%1 = (string) $%2 . '%4';",
+    "switch ($%1) { case %5: $%2 = true; break; default: $%2 = false; }",
+};
+const char *const Variables[] = {"user", "order", "items", "total", "result", "data", "query", "id",
+                                 "name", "value", "count", "list", "row", "entry", "key", "options"};
+
+template <typename T, int N>
+constexpr int countOf(T (&)[N])
+{
+    return N;
+}
+
+// A PHP project's worth of functions, 20 to a file. A tenth of them are
+// copies of an earlier one with a variable renamed and a few statements
+// added, removed or changed, as copy-and-paste leaves them; the rest are
+// random sequences of statements.
+QVector<QByteArray> generatedProject(int functionCount, qint64 *lineCount)
+{
+    QRandomGenerator random(7);
+    auto statement = [&random]() {
+        return QString::fromLatin1(Statements[random.bounded(countOf(Statements))])
+            .replace("%1", Variables[random.bounded(countOf(Variables))])
+            .replace("%2", Variables[random.bounded(countOf(Variables))])
+            .replace("%3", Variables[random.bounded(countOf(Variables))])
+            .replace("%4", Nouns[random.bounded(countOf(Nouns))])
+            .replace("%5", QString::number(random.bounded(100)))
+            .toLatin1();
+    };
+
+    QVector<QVector<QByteArray>> bodies;
+    bodies.reserve(functionCount);
+    for (int function = 0; function < functionCount; ++function) {
+        QVector<QByteArray> body;
+        if (function > 0 && random.bounded(10) == 0) {
+            body = bodies.at(random.bounded(function));
+            for (int edit = random.bounded(3); edit >= 0; --edit) {
+                const int at = random.bounded(int(body.size()));
+                // Chains of copies would otherwise shrink away
+                switch (body.size() > 8 ? random.bounded(3) : 0) {
+                case 0:
+                    body.insert(at, statement());
+                    break;
+                case 1:
+                    body.remove(at);
+                    break;
+                default:
+                    body[at] = statement();
+                    break;
+                }
+            }
+            for (QByteArray &line : body) {
+                line.replace("$result", "$output");
+            }
+        } else {
+            for (int lines = 8 + random.bounded(12); lines > 0; --lines) {
+                body.append(statement());
+            }
+        }
+        bodies.append(body);
+    }
+
+    QVector<QByteArray> files;
+    *lineCount = 0;
+    for (int first = 0; first < functionCount; first += 20) {
+        QByteArray file = "<?php\n\nclass Generated" + QByteArray::number(first / 20) + "\n{\n";
+        qint64 lines = 4;
+        for (int function = first; function < qMin(first + 20, functionCount); ++function) {
+            file += "    public function " + QByteArray(Verbs[function % countOf(Verbs)]) + QByteArray::number(function)
+                + "($user, $options)\n    {\n";
+            for (const QByteArray &line : bodies.at(function)) {
+                file += "        " + line + '\n';
+            }
+            file += "        return $result;\n    }\n\n";
+            lines += bodies.at(function).size() + 5;
+        }
+        file += "}\n";
+        *lineCount += lines + 1;
+        files.append(file);
+    }
+    return files;
+}
+
+// Median, 99th percentile and maximum of some durations, in milliseconds
+QJsonObject latencySummary(QVector<qint64> nsecs)
+{
+    QJsonObject summary;
+    if (nsecs.isEmpty())
+        return summary;
+    std::sort(nsecs.begin(), nsecs.end());
+    auto at = [&nsecs](double fraction) {
+        return double(nsecs.at(qMin(int(nsecs.size() * fraction), int(nsecs.size()) - 1))) / 1e6;
+    };
+    summary["queries"] = int(nsecs.size());
+    summary["p50Milliseconds"] = at(0.5);
+    summary["p99Milliseconds"] = at(0.99);
+    summary["maxMilliseconds"] = double(nsecs.last()) / 1e6;
+    return summary;
+}
+
+// Method, class and function names in camelCase, PascalCase and
+// snake_case; a round number keeps them unique past the word combinations
+QStringList generatedNames(int count)
+{
+    const int combinations = countOf(Verbs) * countOf(Nouns) * countOf(Suffixes);
+    QStringList names;
+    names.reserve(count);
+    for (int i = 0; i < count; ++i) {
+        const int combination = (i / 3) % combinations;
+        const QString verb = Verbs[combination % countOf(Verbs)];
+        const QString noun = Nouns[(combination / countOf(Verbs)) % countOf(Nouns)];
+        const QString suffix = Suffixes[combination / (countOf(Verbs) * countOf(Nouns))];
+        const int round = i / (3 * combinations);
+        QString name;
+        switch (i % 3) {
+        case 0:
+            name = verb + noun + suffix;
+            break;
+        case 1:
+            name = noun + suffix + Roles[combination % countOf(Roles)];
+            break;
+        default:
+            name = verb + '_' + noun.toLower() + (suffix.isEmpty() ? QString() : '_' + suffix.toLower());
+            break;
+        }
+        if (round > 0)
+            name += QString::number(round);
+        names.append(name);
+    }
+    return names;
+}
+
+// What a user types to get a name without its prefix: the first two
+// characters of every word ("getUserName" -> "geUsNa")
+QString abbreviation(const QString &name)
+{
+    QString query;
+    for (int i = 0; i < name.size(); ++i) {
+        const bool wordStart = i == 0 || name.at(i).isUpper() || name.at(i - 1) == QLatin1Char('_');
+        if (wordStart && name.at(i).isLetter()) {
+            query += name.mid(i, 2);
+        }
+    }
+    return query;
+}
+
+// Prefix queries are what completion mostly answers; abbreviations match no
+// prefix and so score every name
+QJsonObject benchmarkCompletion(int nameCount, int queryCount, int limit)
+{
+    const QStringList names = generatedNames(nameCount);
+
+    QElapsedTimer timer;
+    timer.start();
+    const CompletionIndex index(names);
+    const qint64 buildNsecs = timer.nsecsElapsed();
+
+    QRandomGenerator random(7);
+    QVector<qint64> prefixNsecs;
+    QVector<qint64> fuzzyNsecs;
+    int results = 0;
+    for (int query = 0; query < queryCount; ++query) {
+        const QString &name = names.at(random.bounded(int(names.size())));
+        const QString prefix = name.left(1 + random.bounded(4));
+        timer.restart();
+        results += index.complete(prefix, limit).size();
+        prefixNsecs.append(timer.nsecsElapsed());
+
+        const QString fuzzy = abbreviation(name);
+        timer.restart();
+        results += index.complete(fuzzy, limit).size();
+        fuzzyNsecs.append(timer.nsecsElapsed());
+    }
+
+    QJsonObject result;
+    result["names"] = index.size();
+    result["limit"] = limit;
+    result["buildMilliseconds"] = double(buildNsecs) / 1e6;
+    result["prefix"] = latencySummary(prefixNsecs);
+    result["fuzzy"] = latencySummary(fuzzyNsecs);
+    result["averageResults"] = double(results) / (2 * queryCount);
+    return result;
+}
+
+// Symbol extraction before PhpSymbolLexer, kept as it was (one pair of
+// regexes compiled per line, functions only without parameters) so the
+// numbers compare against what indexing used to cost
+QList<IndexedSymbol> regexSymbols(const QByteArray &content)
+{
+    QList<IndexedSymbol> symbols;
+    QTextStream in(content);
+    int lineNumber = 0;
+    while (!in.atEnd()) {
+        QString line = in.readLine();
+        lineNumber++;
+
+        QRegularExpression classRegex("\\bclass\\s+(\\w+)\\b");
+        QRegularExpressionMatch classMatch = classRegex.match(line);
+        if (classMatch.hasMatch())
+            symbols.append(IndexedSymbol{classMatch.captured(1), lineNumber, SymbolKind::Class});
+
+        QRegularExpression functionRegex("\\bfunction\\s+(\\w+)\\s*\\(\\)");
+        QRegularExpressionMatch functionMatch = functionRegex.match(line);
+        if (functionMatch.hasMatch())
+            symbols.append(IndexedSymbol{functionMatch.captured(1), lineNumber, SymbolKind::Function});
+    }
+    return symbols;
+}
+
+// Symbol extraction throughput, the old regexes against the lexer pass
+// (which also collects the references for Find References)
+QJsonObject benchmarkSymbols(int functionCount)
+{
+    qint64 lineCount = 0;
+    const QVector<QByteArray> files = generatedProject(functionCount, &lineCount);
+    qint64 bytes = 0;
+    for (const QByteArray &content : files) {
+        bytes += content.size();
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+    int lexerSymbols = 0;
+    for (const QByteArray &content : files) {
+        PhpSymbolLexer lexer(content);
+        lexer.run();
+        lexerSymbols += lexer.symbols().size();
+    }
+    const qint64 lexerNsecs = timer.nsecsElapsed();
+
+    timer.restart();
+    int regexSymbolCount = 0;
+    for (const QByteArray &content : files) {
+        regexSymbolCount += regexSymbols(content).size();
+    }
+    const qint64 regexNsecs = timer.nsecsElapsed();
+
+    auto megabytesPerSecond = [bytes](qint64 nsecs) {
+        return nsecs > 0 ? (double(bytes) / 1e6) / (double(nsecs) / 1e9) : 0.0;
+    };
+    QJsonObject result;
+    result["files"] = int(files.size());
+    result["lines"] = lineCount;
+    result["bytes"] = bytes;
+    result["lexerMegabytesPerSecond"] = megabytesPerSecond(lexerNsecs);
+    result["lexerSymbols"] = lexerSymbols;
+    result["regexMegabytesPerSecond"] = megabytesPerSecond(regexNsecs);
+    result["regexSymbols"] = regexSymbolCount;
+    return result;
+}
+
+// Repetition detection before the rolling hash and the token suffix
+// array, kept as it was: every 5-line window is joined into a QString,
+// hashed with MD5 and filed under its hex digest in a QMap, snippet and
+// all. Only reading the file is replaced by reading the generated content.
+struct WindowRepetition {
+    QString filePath;
+    int startLine;
+    int endLine;
+    QString snippet;
+};
+
+const int MIN_LINES_FOR_REPETITION = 5;
+
+void analyzeWindows(const QString &filePath, const QByteArray &content,
+                    QMap<QString, QList<WindowRepetition>> &snippetHashes)
+{
+    QTextStream in(content);
+    QList<QString> processedLines;
+    int currentLineNumber = 0;
+
+    QRegularExpression useRegex("^\\s*use\\s+[^;]+;");
+    QRegularExpression classRegex("^\\s*(?:abstract\\s+|final\\s+)?class\\s+\\w+");
+    QRegularExpression namespaceRegex("^\\s*namespace\\s+[A-Za-z0-9_\\]+(?:\\s*;|\\s*\\{)?$");
+
+    while (!in.atEnd()) {
+        QString line = in.readLine();
+        currentLineNumber++;
+
+        // Ignore lines with use, class, or namespace declarations
+        if (line.contains(useRegex) || line.contains(classRegex) || line.contains(namespaceRegex)) {
+            continue;
+        }
+        processedLines.append(line);
+    }
+
+    // Iterate through processed lines to find snippets
+    for (int i = 0; i < processedLines.size() - MIN_LINES_FOR_REPETITION + 1; ++i) {
+        QString currentSnippet;
+        for (int j = 0; j < MIN_LINES_FOR_REPETITION; ++j) {
+            currentSnippet += processedLines.at(i + j) + "\n";
+        }
+
+        // Calculate hash of the snippet
+        QByteArray hash = QCryptographicHash::hash(currentSnippet.toUtf8(), QCryptographicHash::Md5);
+        QString snippetHash = QString(hash.toHex());
+
+        WindowRepetition repetition;
+        repetition.filePath = filePath;
+        repetition.startLine = i + 1; // Line numbers are 1-based
+        repetition.endLine = i + MIN_LINES_FOR_REPETITION;
+        repetition.snippet = currentSnippet.trimmed(); // Store trimmed snippet
+
+        snippetHashes[snippetHash].append(repetition);
+    }
+}
+
+// Tokenizing and the suffix array clone search, as Find Repetitions runs
+// them, against the MD5 window pass it replaced. A generated function is
+// about 19 lines long.
+QJsonObject benchmarkClones(int targetLines)
+{
+    qint64 lineCount = 0;
+    const QVector<QByteArray> files = generatedProject(qMax(1, targetLines / 19), &lineCount);
+
+    QElapsedTimer timer;
+    timer.start();
+    TokenCloneDetector detector;
+    for (const QByteArray &content : files) {
+        detector.addFile(TokenCloneDetector::tokenize(content));
+    }
+    const qint64 tokenizeNsecs = timer.nsecsElapsed();
+
+    timer.restart();
+    const QVector<TokenCloneDetector::CloneClass> clones = detector.detect(CodeAnalyzer::MinCloneTokens);
+    const qint64 detectNsecs = timer.nsecsElapsed();
+
+    // The baseline holds every window of the project in memory, as the
+    // original did
+    timer.restart();
+    int repeatedWindows = 0;
+    {
+        QMap<QString, QList<WindowRepetition>> snippetHashes;
+        for (int i = 0; i < files.size(); ++i) {
+            analyzeWindows(QString("Generated%1.php").arg(i), files.at(i), snippetHashes);
+        }
+        // Now, identify actual repetitions (snippets appearing more than once)
+        for (auto it = snippetHashes.constBegin(); it != snippetHashes.constEnd(); ++it) {
+            if (it.value().size() > 1) {
+                repeatedWindows += it.value().size();
+            }
+        }
+    }
+    const qint64 baselineNsecs = timer.nsecsElapsed();
+
+    QJsonObject result;
+    result["files"] = int(files.size());
+    result["lines"] = lineCount;
+    result["tokens"] = detector.tokenCount();
+    result["tokenizeMilliseconds"] = double(tokenizeNsecs) / 1e6;
+    result["detectMilliseconds"] = double(detectNsecs) / 1e6;
+    result["cloneClasses"] = int(clones.size());
+    result["md5WindowsMilliseconds"] = double(baselineNsecs) / 1e6;
+    result["md5RepeatedWindows"] = repeatedWindows;
+    result["speedup"] = double(baselineNsecs) / double(qMax<qint64>(1, tokenizeNsecs + detectNsecs));
+    return result;
+}
+
+// Function signatures and the LSH pair search, as Find Similar Functions
+// runs them
+QJsonObject benchmarkSimilarity(int functionCount)
+{
+    qint64 lineCount = 0;
+    const QVector<QByteArray> files = generatedProject(functionCount, &lineCount);
+
+    QElapsedTimer timer;
+    timer.start();
+    NearDuplicateDetector detector;
+    for (const QByteArray &content : files) {
+        detector.addFile(TokenCloneDetector::tokenize(content));
+    }
+    const qint64 signatureNsecs = timer.nsecsElapsed();
+
+    timer.restart();
+    qint64 skippedPairs = 0;
+    const QVector<NearDuplicateDetector::SimilarPair> pairs =
+        detector.detect(CodeAnalyzer::MinSimilarity, NearDuplicateDetector::Callback(), &skippedPairs);
+    const qint64 detectNsecs = timer.nsecsElapsed();
+
+    QJsonObject result;
+    result["files"] = int(files.size());
+    result["lines"] = lineCount;
+    result["functions"] = int(detector.functions().size());
+    result["tokenizeAndSignatureMilliseconds"] = double(signatureNsecs) / 1e6;
+    result["detectMilliseconds"] = double(detectNsecs) / 1e6;
+    result["similarPairs"] = int(pairs.size());
+    result["skippedPairs"] = skippedPairs;
+    return result;
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("incode-core-bench");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Times indexing and analysis components on generated input and prints JSON.");
+    parser.addHelpOption();
+    QCommandLineOption completionOption("completion", "Completion queries against a generated symbol index.");
+    QCommandLineOption namesOption("names", "Symbol names in the completion index (default 500000).", "count", "500000");
+    QCommandLineOption queriesOption("queries", "Completion queries of each kind (default 500).", "count", "500");
+    QCommandLineOption symbolsOption("symbols", "Symbol extraction on a generated project, lexer against regexes.");
+    QCommandLineOption clonesOption("clones", "Clone detection on a generated project.");
+    QCommandLineOption linesOption("lines", "Lines in the generated project for --clones (default 1000000).", "count",
+                                   "1000000");
+    QCommandLineOption similarityOption("similarity", "Similar function search on a generated project.");
+    QCommandLineOption functionsOption("functions",
+                                       "Functions in the generated project for --symbols and --similarity (default 100000).",
+                                       "count", "100000");
+    parser.addOptions({completionOption, namesOption, queriesOption, symbolsOption, clonesOption, linesOption,
+                       similarityOption, functionsOption});
+    parser.process(app);
+
+    // No section named means all of them
+    const bool all = !parser.isSet(completionOption) && !parser.isSet(symbolsOption) && !parser.isSet(clonesOption)
+        && !parser.isSet(similarityOption);
+
+    QJsonObject report;
+    if (all || parser.isSet(completionOption)) {
+        report["completion"] = benchmarkCompletion(qMax(1, parser.value(namesOption).toInt()),
+                                                   qMax(1, parser.value(queriesOption).toInt()), 50);
+    }
+    if (all || parser.isSet(symbolsOption))
+        report["symbols"] = benchmarkSymbols(qMax(1, parser.value(functionsOption).toInt()));
+    if (all || parser.isSet(clonesOption))
+        report["clones"] = benchmarkClones(qMax(1, parser.value(linesOption).toInt()));
+    if (all || parser.isSet(similarityOption))
+        report["similarity"] = benchmarkSimilarity(qMax(1, parser.value(functionsOption).toInt()));
+
+    QTextStream(stdout) << QJsonDocument(report).toJson(QJsonDocument::Indented);
+    return 0;
+}
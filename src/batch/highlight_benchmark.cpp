@@ -0,0 +1,235 @@
+// incode-highlight-bench: measures PHP syntax highlighting in blocks per
+// second, for PHPSyntaxHighlighter and for the regex rules it replaced, and
+// prints the results as JSON. Runs without a display.
+
+#include "PhpHighlightLexer.h"
+#include "widgets/PHPSyntaxHighlighter.h"
+#include <QCommandLineParser>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QGuiApplication>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QRandomGenerator>
+#include <QRegularExpression>
+#include <QSyntaxHighlighter>
+#include <QTextBlock>
+#include <QTextCursor>
+#include <QTextDocument>
+#include <QTextStream>
+
+namespace {
+
+// PHPSyntaxHighlighter before the lexer, kept as it was (the "\b" escapes
+// are backspaces, not word boundaries) so the numbers compare against what
+// users actually had
+class RegexHighlighter : public QSyntaxHighlighter
+{
+public:
+    explicit RegexHighlighter(QTextDocument *parent) : QSyntaxHighlighter(parent)
+    {
+        HighlightingRule rule;
+        keywordFormat.setForeground(QColor("#C678DD"));
+        rule.pattern = QRegularExpression("\b(abstract|and|array|as|break|callable|case|catch|class|clone|const|continue|declare|default|die|do|echo|else|elseif|empty|enddeclare|endfor|endforeach|endif|endswitch|endwhile|eval|exit|extends|final|for|foreach|function|global|goto|if|implements|include|include_once|instanceof|insteadof|interface|isset|list|namespace|new|or|print|private|protected|public|require|require_once|return|static|switch|throw|trait|try|unset|use|var|while|xor|yield)\b");
+        rule.format = keywordFormat;
+        highlightingRules.append(rule);
+        classFormat.setForeground(QColor("#E5C07B"));
+        rule.pattern = QRegularExpression("\b[A-Z][A-Za-z0-9_]+\b");
+        rule.format = classFormat;
+        highlightingRules.append(rule);
+        singleLineCommentFormat.setForeground(QColor("#5C6370"));
+        rule.pattern = QRegularExpression("//[^\n]*");
+        rule.format = singleLineCommentFormat;
+        highlightingRules.append(rule);
+        multiLineCommentFormat.setForeground(QColor("#5C6370"));
+        quotationFormat.setForeground(QColor("#98C379"));
+        rule.pattern = QRegularExpression("(\"|[quote]).*?\\1");
+        rule.format = quotationFormat;
+        highlightingRules.append(rule);
+        functionFormat.setForeground(QColor("#61AFEF"));
+        rule.pattern = QRegularExpression("\b[A-Za-z0-9_]+(?=\\()\b");
+        rule.format = functionFormat;
+        highlightingRules.append(rule);
+    }
+
+protected:
+    void highlightBlock(const QString &text) override
+    {
+        for (const HighlightingRule &rule : std::as_const(highlightingRules)) {
+            QRegularExpressionMatchIterator matchIterator = rule.pattern.globalMatch(text);
+            while (matchIterator.hasNext()) {
+                QRegularExpressionMatch match = matchIterator.next();
+                setFormat(match.capturedStart(), match.capturedLength(), rule.format);
+            }
+        }
+        setCurrentBlockState(0);
+        int startIndex = 0;
+        if (previousBlockState() != 1)
+            startIndex = text.indexOf("/*");
+        while (startIndex >= 0) {
+            int endIndex = text.indexOf("*/", startIndex + 2);
+            int commentLength;
+            if (endIndex == -1) {
+                setCurrentBlockState(1);
+                commentLength = text.length() - startIndex;
+            } else {
+                commentLength = endIndex - startIndex + 2;
+            }
+            setFormat(startIndex, commentLength, multiLineCommentFormat);
+            startIndex = text.indexOf("/*", startIndex + commentLength);
+        }
+    }
+
+private:
+    struct HighlightingRule {
+        QRegularExpression pattern;
+        QTextCharFormat format;
+    };
+    QList<HighlightingRule> highlightingRules;
+    QTextCharFormat keywordFormat;
+    QTextCharFormat classFormat;
+    QTextCharFormat singleLineCommentFormat;
+    QTextCharFormat multiLineCommentFormat;
+    QTextCharFormat quotationFormat;
+    QTextCharFormat functionFormat;
+};
+
+// A Laravel-style class repeated to the requested length, with the
+// constructs that carry state across lines
+QString generatedSource(int lineCount)
+{
+    static const char *const Chunk =
+        "    /**\n"
+        "     * Store a newly created resource in storage.\n"
+        "     */\n"
+        "    public function store%1(Request $request): RedirectResponse\n"
+        "    {\n"
+        "        $validated = $request->validate(['title' => 'required|max:255', \"body\" => 'required']);\n"
+        "        // Only the owner may publish\n"
+        "        if ($request->user()?->cannot('publish', Post::class)) {\n"
+        "            throw new AuthorizationException(\"Not allowed for {$request->user()->name}\");\n"
+        "        }\n"
+        "        $sql = <<<SQL\n"
+        "            SELECT * FROM posts WHERE id = ?\n"
+        "            SQL;\n"
+        "        foreach ($validated as $key => $value) { $this->items[$key] = trim($value); }\n"
+        "        return redirect()->route('posts.index')->with('status', __('Saved'));\n"
+        "    }\n\n";
+
+    QString source = "<?php\n\nnamespace App\\Http\\Controllers;\n\nuse Illuminate\\Http\\Request;\n\n"
+                     "class PostController extends Controller\n{\n";
+    const int chunkLines = int(QString(Chunk).count('\n'));
+    for (int i = 0, lines = int(source.count('\n')); lines < lineCount; ++i, lines += chunkLines) {
+        source += QString(Chunk).arg(i);
+    }
+    return source + "}\n";
+}
+
+// Loading the document with the highlighter attached (what opening a file
+// waits for), full passes over it, then single-character edits at random
+// lines, each of which re-highlights until the block state settles
+template <typename Highlighter>
+QJsonObject measure(const QString &source, int runs)
+{
+    QTextDocument document;
+    Highlighter highlighter(&document);
+
+    QElapsedTimer timer;
+    timer.start();
+    document.setPlainText(source);
+    const qint64 openNsecs = timer.nsecsElapsed();
+
+    timer.restart();
+    for (int run = 0; run < runs; ++run) {
+        highlighter.rehighlight();
+    }
+    const qint64 fullNsecs = qMax<qint64>(timer.nsecsElapsed(), 1);
+
+    const int edits = 200;
+    QRandomGenerator random(7);
+    timer.restart();
+    for (int edit = 0; edit < edits; ++edit) {
+        QTextCursor cursor(document.findBlockByNumber(random.bounded(document.blockCount())));
+        cursor.insertText("x");
+    }
+    const qint64 editNsecs = timer.nsecsElapsed();
+
+    QJsonObject result;
+    result["openMilliseconds"] = double(openNsecs) / 1e6;
+    result["blocksPerSecond"] = double(document.blockCount()) * runs * 1e9 / fullNsecs;
+    result["editMicroseconds"] = double(editNsecs) / edits / 1000;
+    return result;
+}
+
+QJsonObject measureLexer(const QString &source, int runs)
+{
+    const QStringList lines = source.split('\n');
+    PhpHighlightLexer lexer;
+    QVector<PhpHighlightLexer::Span> spans;
+    qint64 spanCount = 0;
+
+    QElapsedTimer timer;
+    timer.start();
+    for (int run = 0; run < runs; ++run) {
+        int state = PhpHighlightLexer::InitialState;
+        for (const QString &line : lines) {
+            state = lexer.highlightLine(line, state, spans);
+            spanCount += spans.size();
+        }
+    }
+    const qint64 nsecs = qMax<qint64>(timer.nsecsElapsed(), 1);
+
+    QJsonObject result;
+    result["blocksPerSecond"] = double(lines.size()) * runs * 1e9 / nsecs;
+    result["spansPerBlock"] = double(spanCount) / (qint64(lines.size()) * runs);
+    return result;
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    // Text layout needs a platform plugin, not a screen
+    if (qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM"))
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+    QGuiApplication app(argc, argv);
+    QCoreApplication::setApplicationName("incode-highlight-bench");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Measures PHP syntax highlighting throughput and prints JSON.");
+    parser.addHelpOption();
+    parser.addPositionalArgument("file", "PHP file to highlight (default: generated source).", "[file]");
+    QCommandLineOption linesOption("lines", "Length of the generated source (default 10000).", "count", "10000");
+    QCommandLineOption runsOption("runs", "Full highlighting passes per implementation (default 5).", "count", "5");
+    parser.addOptions({linesOption, runsOption});
+    parser.process(app);
+
+    QString source;
+    QString input = "generated";
+    if (!parser.positionalArguments().isEmpty()) {
+        QFile file(parser.positionalArguments().first());
+        if (!file.open(QIODevice::ReadOnly)) {
+            QTextStream(stderr) << "Could not read " << file.fileName() << "\n";
+            return 1;
+        }
+        source = QString::fromUtf8(file.readAll());
+        input = file.fileName();
+    } else {
+        source = generatedSource(parser.value(linesOption).toInt());
+    }
+    const int runs = qMax(1, parser.value(runsOption).toInt());
+
+    QJsonObject report;
+    report["input"] = input;
+    report["blocks"] = int(source.count('\n') + 1);
+    report["runs"] = runs;
+    const QJsonObject regex = measure<RegexHighlighter>(source, runs);
+    const QJsonObject stateMachine = measure<PHPSyntaxHighlighter>(source, runs);
+    report["regex"] = regex;
+    report["stateMachine"] = stateMachine;
+    report["lexerOnly"] = measureLexer(source, runs);
+    report["speedup"] = stateMachine["blocksPerSecond"].toDouble() / regex["blocksPerSecond"].toDouble();
+
+    QTextStream(stdout) << QJsonDocument(report).toJson(QJsonDocument::Indented);
+    return 0;
+}
@@ -0,0 +1,249 @@
+// incode-batch: indexes and/or analyzes a PHP project without a display and
+// prints the results as JSON. Intended for CI (duplication gates) and for
+// tracking indexing performance over time.
+
+#include "SimpleSymbolIndexer.h"
+#include "CodeAnalyzer.h"
+#include "ProjectScanner.h"
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QLoggingCategory>
+#include <QTextStream>
+#include <QThread>
+
+namespace {
+
+enum ExitCode {
+    ExitOk = 0,
+    ExitUsage = 1,
+    ExitDuplicationGate = 2
+};
+
+// Peak resident set size in KiB, or -1 where /proc isn't available
+qint64 peakMemoryKb()
+{
+    QFile status("/proc/self/status");
+    if (!status.open(QIODevice::ReadOnly | QIODevice::Text))
+        return -1;
+    const QList<QByteArray> lines = status.readAll().split('\n');
+    for (const QByteArray &line : lines) {
+        if (line.startsWith("VmHWM:"))
+            return line.mid(6).trimmed().split(' ').first().toLongLong();
+    }
+    return -1;
+}
+
+QJsonObject runIndex(const QString &directory, int threads, bool useCache, bool tokenizeForAnalysis)
+{
+    SimpleSymbolIndexer indexer;
+    indexer.setThreadCount(threads);
+    indexer.setCacheEnabled(useCache);
+    // Lets a following analysis reuse this pass's file reads
+    if (tokenizeForAnalysis) {
+        indexer.addScanConsumer(std::make_shared<AnalysisScanConsumer>());
+    }
+    // Same thread, so this runs doIndexDirectory synchronously
+    QObject::connect(&indexer, &SimpleSymbolIndexer::startIndexing, &indexer, &SimpleSymbolIndexer::doIndexDirectory);
+
+    QElapsedTimer timer;
+    timer.start();
+    indexer.indexDirectory(directory);
+    const qint64 elapsed = timer.elapsed();
+
+    const std::shared_ptr<const IndexSnapshot> snapshot = indexer.snapshot();
+    QJsonObject result;
+    result["threads"] = indexer.threadCount();
+    result["cache"] = useCache;
+    result["elapsedMs"] = elapsed;
+    result["files"] = snapshot->symbols.fileCount();
+    result["symbols"] = snapshot->symbols.symbolCount();
+    result["names"] = snapshot->symbols.nameCount();
+    result["symbolTableBytes"] = qint64(snapshot->symbols.memoryUsage());
+    result["referenceIndexBytes"] = qint64(snapshot->references.memoryUsage());
+    return result;
+}
+
+QJsonObject runAnalysis(const QString &directory, CodeAnalyzer::AnalysisMode mode, int threads, bool useCache,
+                        int maxReported, bool memoryReport)
+{
+    CodeAnalyzer analyzer;
+    analyzer.setThreadCount(threads);
+    analyzer.setCacheEnabled(useCache);
+    // Same thread, so this runs doAnalyzePaths synchronously
+    QObject::connect(&analyzer, &CodeAnalyzer::startAnalysis, &analyzer, &CodeAnalyzer::doAnalyzePaths);
+    RepetitionResults results;
+    QObject::connect(&analyzer, &CodeAnalyzer::analysisFinished, [&results](const RepetitionResults &found) {
+        results = found;
+    });
+
+    QElapsedTimer timer;
+    timer.start();
+    analyzer.analyzePaths(QList<QString>() << directory, directory, mode);
+    const qint64 elapsed = timer.elapsed();
+
+    const QDir root(directory);
+    QJsonArray items;
+    for (const CodeRepetition &repetition : std::as_const(results.repetitions)) {
+        if (items.size() >= maxReported)
+            break;
+        QJsonObject item;
+        item["group"] = repetition.groupId;
+        if (mode == CodeAnalyzer::SimilarityAnalysis)
+            item["similarity"] = results.similarities.at(repetition.groupId);
+        else
+            item["hash"] = QString::number(repetition.hash, 16);
+        item["file"] = root.relativeFilePath(results.filePath(repetition));
+        item["startLine"] = repetition.startLine;
+        item["endLine"] = repetition.endLine;
+        items.append(item);
+    }
+
+    QJsonObject result;
+    result["threads"] = analyzer.threadCount();
+    result["cache"] = useCache;
+    result["elapsedMs"] = elapsed;
+    result["repetitions"] = int(results.repetitions.size());
+    result[mode == CodeAnalyzer::SimilarityAnalysis ? "similarPairs" : "cloneClasses"] = results.groupCount();
+    result["items"] = items;
+    if (memoryReport) {
+        // Compact location records against one path and snippet copy per repetition
+        QJsonObject memory;
+        memory["compactBytes"] = qint64(results.memoryUsage());
+        memory["eagerBytes"] = qint64(results.eagerMemoryUsage());
+        memory["recordBytes"] = int(sizeof(CodeRepetition));
+        result["memory"] = memory;
+    }
+    return result;
+}
+
+QJsonObject walkReport(const QString &directory, const IgnoreRules &rules)
+{
+    QElapsedTimer timer;
+    timer.start();
+    WalkStats stats;
+    ProjectScanner::walk(QStringList() << directory, rules, ProjectScanner::CancelCheck(), &stats);
+
+    QJsonObject result;
+    result["elapsedMs"] = timer.elapsed();
+    result["directories"] = stats.directories;
+    result["prunedDirectories"] = stats.prunedDirectories;
+    result["files"] = stats.files;
+    result["ignoredFiles"] = stats.ignoredFiles;
+    result["bytes"] = stats.bytes;
+    return result;
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("incode-batch");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Indexes and analyzes a PHP project and prints the results as JSON.");
+    parser.addHelpOption();
+    parser.addPositionalArgument("directory", "Project directory.");
+    QCommandLineOption indexOption("index", "Build the symbol index.");
+    QCommandLineOption analyzeOption("analyze", "Run repetition analysis.");
+    QCommandLineOption similarityOption("similarity", "Find pairs of similar functions.");
+    QCommandLineOption threadsOption("threads", "Worker threads (default: one per core).", "count", "0");
+    QCommandLineOption noCacheOption("no-cache", "Ignore and don't write the .incode caches.");
+    QCommandLineOption benchmarkOption("benchmark-threads", "Index once per thread count, without the cache, e.g. 1,2,4,8.", "counts");
+    QCommandLineOption maxRepetitionsOption("max-repetitions", "Exit with code 2 when more repetitions are found.", "count");
+    QCommandLineOption maxReportedOption("max-reported", "Maximum repetitions listed in the output (default 1000).", "count", "1000");
+    QCommandLineOption memoryReportOption("memory-report", "Compare the memory of the analysis results with snippet copies.");
+    QCommandLineOption scanReportOption("scan-report", "Compare a walk with and without the ignore rules.");
+    QCommandLineOption outputOption(QStringList() << "o" << "output", "Write JSON to a file instead of stdout.", "file");
+    QCommandLineOption verboseOption("verbose", "Print debug logging to stderr.");
+    parser.addOptions({indexOption, analyzeOption, similarityOption, threadsOption, noCacheOption, benchmarkOption,
+                       maxRepetitionsOption, maxReportedOption, memoryReportOption, scanReportOption, outputOption, verboseOption});
+    parser.process(app);
+
+    const QStringList positional = parser.positionalArguments();
+    if (positional.size() != 1 || !QFileInfo(positional.first()).isDir()) {
+        QTextStream(stderr) << "Expected exactly one project directory.\n";
+        parser.showHelp(ExitUsage);
+    }
+    const QString directory = QDir(positional.first()).absolutePath();
+
+    if (!parser.isSet(verboseOption)) {
+        QLoggingCategory::setFilterRules("*.debug=false");
+    }
+
+    // Neither flag means both
+    const bool benchmark = parser.isSet(benchmarkOption);
+    bool index = parser.isSet(indexOption);
+    bool analyze = parser.isSet(analyzeOption);
+    const bool similarity = parser.isSet(similarityOption);
+    if (!index && !analyze && !similarity && !benchmark && !parser.isSet(scanReportOption)) {
+        index = true;
+        analyze = true;
+    }
+
+    QJsonObject report;
+    report["directory"] = directory;
+    report["idealThreadCount"] = QThread::idealThreadCount();
+
+    if (index) {
+        // The analysis cache is how the shared pass hands tokens over
+        const bool useCache = !parser.isSet(noCacheOption);
+        report["index"] = runIndex(directory, parser.value(threadsOption).toInt(), useCache, (analyze || similarity) && useCache);
+    }
+
+    if (benchmark) {
+        QJsonArray runs;
+        const QStringList counts = parser.value(benchmarkOption).split(',', Qt::SkipEmptyParts);
+        for (const QString &count : counts) {
+            runs.append(runIndex(directory, count.trimmed().toInt(), false, false));
+        }
+        report["benchmark"] = runs;
+    }
+
+    if (parser.isSet(scanReportOption)) {
+        QJsonObject scan;
+        scan["withIgnoreRules"] = walkReport(directory, IgnoreRules::forProject(directory));
+        scan["withoutIgnoreRules"] = walkReport(directory, IgnoreRules());
+        report["scan"] = scan;
+    }
+
+    int exitCode = ExitOk;
+    if (analyze) {
+        const QJsonObject analysis = runAnalysis(directory, CodeAnalyzer::CloneAnalysis, parser.value(threadsOption).toInt(),
+                                                 !parser.isSet(noCacheOption), parser.value(maxReportedOption).toInt(),
+                                                 parser.isSet(memoryReportOption));
+        report["analysis"] = analysis;
+        if (parser.isSet(maxRepetitionsOption)
+            && analysis["repetitions"].toInt() > parser.value(maxRepetitionsOption).toInt()) {
+            exitCode = ExitDuplicationGate;
+        }
+    }
+
+    if (similarity) {
+        report["similarity"] = runAnalysis(directory, CodeAnalyzer::SimilarityAnalysis, parser.value(threadsOption).toInt(),
+                                           !parser.isSet(noCacheOption), parser.value(maxReportedOption).toInt(),
+                                           parser.isSet(memoryReportOption));
+    }
+
+    report["peakMemoryKb"] = peakMemoryKb();
+
+    const QByteArray json = QJsonDocument(report).toJson(QJsonDocument::Indented);
+    if (parser.isSet(outputOption)) {
+        QFile output(parser.value(outputOption));
+        if (!output.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+            QTextStream(stderr) << "Could not write " << output.fileName() << "\n";
+            return ExitUsage;
+        }
+        output.write(json);
+    } else {
+        QTextStream(stdout) << json;
+    }
+    return exitCode;
+}
@@ -1,5 +1,6 @@
 #include "CodeEditor.h"
 #include "PHPSyntaxHighlighter.h"
+#include "../LatencyProfiler.h"
 
 #include <QPainter>
 #include <QTextBlock>
@@ -10,9 +11,13 @@
 #include <QFontDatabase>
 #include <QStringListModel>
 #include <QScrollBar>
+#include <QMenu>
+#include <QAction>
+#include <QContextMenuEvent>
 
 CodeEditor::CodeEditor(ISymbolProvider *provider, QWidget *parent)
-    : QPlainTextEdit(parent), symbolProvider(provider), completer(new QCompleter(this))
+    : QPlainTextEdit(parent), symbolProvider(provider), completer(new QCompleter(this)),
+      findReferencesAction(nullptr), completionModel(new QStringListModel(this))
 {
     lineNumberArea = new LineNumberArea(this);
 
@@ -31,14 +36,25 @@ CodeEditor::CodeEditor(ISymbolProvider *provider, QWidget *parent)
     font.setPointSize(10);
     setFont(font);
 
+    // Large files are colored in the background; whatever scrolls into view
+    // is colored first
     highlighter = new PHPSyntaxHighlighter(document());
+    connect(verticalScrollBar(), &QScrollBar::valueChanged, this, &CodeEditor::highlightVisibleBlocks);
 
+    // The symbol provider already filters and ranks, so the completer just
+    // shows its model as is
     completer->setWidget(this);
-    completer->setCompletionMode(QCompleter::PopupCompletion);
+    completer->setModel(completionModel);
+    completer->setCompletionMode(QCompleter::UnfilteredPopupCompletion);
     completer->setCaseSensitivity(Qt::CaseInsensitive);
     connect(completer, QOverload<const QString &>::of(&QCompleter::activated),
             this, &CodeEditor::insertCompletion);
-    updateCompleter();
+
+    findReferencesAction = new QAction(tr("Find References"), this);
+    findReferencesAction->setShortcut(QKeySequence(Qt::SHIFT | Qt::Key_F12));
+    findReferencesAction->setShortcutContext(Qt::WidgetShortcut);
+    connect(findReferencesAction, &QAction::triggered, this, &CodeEditor::requestFindReferences);
+    addAction(findReferencesAction);
 }
 
 int CodeEditor::lineNumberAreaWidth()
@@ -74,10 +90,26 @@ void CodeEditor::resizeEvent(QResizeEvent *event)
 
     QRect cr = contentsRect();
     lineNumberArea->setGeometry(QRect(cr.left(), cr.top(), lineNumberAreaWidth(), cr.height()));
+    highlightVisibleBlocks();
+}
+
+void CodeEditor::highlightVisibleBlocks()
+{
+    QTextBlock block = firstVisibleBlock();
+    const int first = block.blockNumber();
+    int last = first;
+    qreal top = blockBoundingGeometry(block).translated(contentOffset()).top();
+    while (block.isValid() && top <= viewport()->height()) {
+        top += blockBoundingRect(block).height();
+        block = block.next();
+        ++last;
+    }
+    highlighter->highlightBlocks(first, last);
 }
 
 void CodeEditor::highlightCurrentLine()
 {
+    LatencyProfiler::Scope profile(LatencyProfiler::CurrentLine);
     QList<QTextEdit::ExtraSelection> extraSelections;
 
     if (!isReadOnly()) {
@@ -97,6 +129,7 @@ void CodeEditor::highlightCurrentLine()
 
 void CodeEditor::lineNumberAreaPaintEvent(QPaintEvent *event)
 {
+    LatencyProfiler::Scope profile(LatencyProfiler::LineNumbers);
     QPainter painter(lineNumberArea);
     painter.fillRect(event->rect(), QColor("#21252b"));
 
@@ -120,14 +153,21 @@ void CodeEditor::lineNumberAreaPaintEvent(QPaintEvent *event)
     }
 }
 
+void CodeEditor::paintEvent(QPaintEvent *event)
+{
+    {
+        LatencyProfiler::Scope profile(LatencyProfiler::ViewportPaint);
+        QPlainTextEdit::paintEvent(event);
+    }
+    LatencyProfiler::instance().painted();
+}
+
 void CodeEditor::mousePressEvent(QMouseEvent *event)
 {
     if (event->modifiers() & Qt::ControlModifier) {
-        QTextCursor cursor = cursorForPosition(event->pos());
-        cursor.select(QTextCursor::WordUnderCursor);
-        QString word = cursor.selectedText();
-        if (!word.isEmpty()) {
-            emit goToDefinitionRequested(word);
+        const QString name = qualifiedNameAt(cursorForPosition(event->pos()));
+        if (!name.isEmpty()) {
+            emit goToDefinitionRequested(name);
         }
     }
     QPlainTextEdit::mousePressEvent(event);
@@ -153,6 +193,9 @@ void CodeEditor::mouseMoveEvent(QMouseEvent *event)
 
 void CodeEditor::keyPressEvent(QKeyEvent *event)
 {
+    LatencyProfiler::instance().keyPressed();
+    LatencyProfiler::Scope profile(LatencyProfiler::KeyPress);
+
     if (completer && completer->popup()->isVisible()) {
         switch (event->key()) {
         case Qt::Key_Enter:
@@ -170,12 +213,14 @@ void CodeEditor::keyPressEvent(QKeyEvent *event)
     QPlainTextEdit::keyPressEvent(event);
 
     QString prefix = textUnderCursor();
-    if (!prefix.isEmpty()) {
+    updateCompletions(prefix);
+    if (completionModel->rowCount() > 0) {
         completer->setCompletionPrefix(prefix);
         QRect rect = cursorRect();
         rect.setWidth(completer->popup()->sizeHintForColumn(0)
                        + completer->popup()->verticalScrollBar()->sizeHint().width());
         completer->complete(rect);
+        completer->popup()->setCurrentIndex(completionModel->index(0, 0));
     } else {
         completer->popup()->hide();
     }
@@ -188,6 +233,28 @@ void CodeEditor::focusInEvent(QFocusEvent *event)
     QPlainTextEdit::focusInEvent(event);
 }
 
+void CodeEditor::contextMenuEvent(QContextMenuEvent *event)
+{
+    // Act on the word that was right-clicked, not wherever the cursor was
+    if (!textCursor().hasSelection())
+        setTextCursor(cursorForPosition(event->pos()));
+
+    QMenu *menu = createStandardContextMenu();
+    menu->addSeparator();
+    menu->addAction(findReferencesAction);
+    findReferencesAction->setEnabled(!textUnderCursor().isEmpty());
+    menu->exec(event->globalPos());
+    findReferencesAction->setEnabled(true);
+    delete menu;
+}
+
+void CodeEditor::requestFindReferences()
+{
+    const QString word = textUnderCursor();
+    if (!word.isEmpty())
+        emit findReferencesRequested(word);
+}
+
 void CodeEditor::insertCompletion(const QString &completion)
 {
     QTextCursor cursor = textCursor();
@@ -203,19 +270,95 @@ QString CodeEditor::textUnderCursor() const
     return cursor.selectedText();
 }
 
+QString CodeEditor::qualifiedNameAt(QTextCursor cursor) const
+{
+    cursor.select(QTextCursor::WordUnderCursor);
+    if (!cursor.hasSelection())
+        return QString();
+
+    // Include a namespace qualifier written before the word (Support\Str, \Foo\Bar)
+    const QString line = cursor.block().text();
+    const int end = cursor.selectionEnd() - cursor.block().position();
+    int start = cursor.selectionStart() - cursor.block().position();
+    while (start > 0 && (line.at(start - 1).isLetterOrNumber() || line.at(start - 1) == '_' || line.at(start - 1) == '\\'))
+        --start;
+    return line.mid(start, end - start);
+}
+
 void CodeEditor::setSymbolProvider(ISymbolProvider *provider)
 {
     symbolProvider = provider;
-    updateCompleter();
 }
 
-void CodeEditor::updateCompleter()
+QString CodeEditor::filePath() const
+{
+    return currentFilePath;
+}
+
+void CodeEditor::setFilePath(const QString &path)
+{
+    currentFilePath = path;
+}
+
+void CodeEditor::goToLine(int lineNumber)
 {
-    if (!completer)
+    if (loading && lineNumber > blockCount()) {
+        pendingLine = lineNumber;
         return;
+    }
+    pendingLine = 0;
+    QTextBlock block = document()->findBlockByNumber(qMax(0, lineNumber - 1));
+    if (!block.isValid())
+        block = document()->lastBlock();
+    QTextCursor cursor(block);
+    setTextCursor(cursor);
+    centerCursor();
+    setFocus();
+}
+
+void CodeEditor::beginLoading()
+{
+    loading = true;
+    setReadOnly(true);
+    setPlaceholderText(tr("Loading..."));
+    document()->setUndoRedoEnabled(false);
+}
+
+void CodeEditor::appendLoadedText(const QString &text)
+{
+    // A cursor of its own, so the user's cursor and scroll position stay put
+    QTextCursor cursor(document());
+    cursor.movePosition(QTextCursor::End);
+    cursor.insertText(text);
+
+    // Less than a whole line may have arrived, so wait for the one after it
+    if (pendingLine > 0 && pendingLine < blockCount())
+        goToLine(pendingLine);
+}
+
+void CodeEditor::finishLoading()
+{
+    loading = false;
+    setPlaceholderText(QString());
+    setReadOnly(false);
+    document()->setUndoRedoEnabled(true);
+    document()->setModified(false);
+    highlightCurrentLine();
+    if (pendingLine > 0)
+        goToLine(pendingLine);
+}
+
+bool CodeEditor::isLoading() const
+{
+    return loading;
+}
+
+void CodeEditor::updateCompletions(const QString &prefix)
+{
+    LatencyProfiler::Scope profile(LatencyProfiler::Completion);
     QStringList words;
-    if (symbolProvider)
-        words = symbolProvider->allSymbols();
-    completer->setModel(new QStringListModel(words, completer));
+    if (symbolProvider && !prefix.isEmpty())
+        words = symbolProvider->completeSymbol(prefix, MaxCompletions);
+    completionModel->setStringList(words);
 }
 
@@ -13,6 +13,9 @@ class QSize;
 class QWidget;
 class QKeyEvent;
 class QFocusEvent;
+class QStringListModel;
+class QContextMenuEvent;
+class QAction;
 
 class LineNumberArea; // Forward declaration
 
@@ -27,32 +30,62 @@ public:
     int lineNumberAreaWidth();
     void setSymbolProvider(ISymbolProvider *provider);
 
+    // File shown in this editor; empty for unsaved new files
+    QString filePath() const;
+    void setFilePath(const QString &path);
+
+    // Moves the cursor to a 1-based line and scrolls it into view; while
+    // loading, as soon as that line has arrived
+    void goToLine(int lineNumber);
+
+    // Streaming a file in: the editor stays read-only and shows a loading
+    // placeholder until finishLoading(), and the inserts can't be undone
+    void beginLoading();
+    void appendLoadedText(const QString &text);
+    void finishLoading();
+    bool isLoading() const;
+
 signals:
+    // symbolName includes a namespace qualifier if one is written before it
     void goToDefinitionRequested(const QString &symbolName);
+    void findReferencesRequested(const QString &symbolName);
 
 protected:
     void resizeEvent(QResizeEvent *event) override;
+    void paintEvent(QPaintEvent *event) override;
     void mousePressEvent(QMouseEvent *event) override;
     void mouseMoveEvent(QMouseEvent *event) override;
     void keyPressEvent(QKeyEvent *event) override;
     void focusInEvent(QFocusEvent *event) override;
+    void contextMenuEvent(QContextMenuEvent *event) override;
 
 private slots:
     void updateLineNumberAreaWidth(int newBlockCount);
     void highlightCurrentLine();
     void updateLineNumberArea(QRectF rect);
+    void highlightVisibleBlocks();
 
 private slots:
     void insertCompletion(const QString &completion);
+    void requestFindReferences();
 
 private:
     QString textUnderCursor() const;
-    void updateCompleter();
+    // Word at the cursor together with the namespace qualifier before it
+    QString qualifiedNameAt(QTextCursor cursor) const;
+    void updateCompletions(const QString &prefix);
 
     QWidget *lineNumberArea;
     class PHPSyntaxHighlighter *highlighter;
     ISymbolProvider *symbolProvider;
     QCompleter *completer;
+    QAction *findReferencesAction;
+    QString currentFilePath;
+    QStringListModel *completionModel; // Only the current candidates, ranked by the provider
+    bool loading = false;
+    int pendingLine = 0; // goToLine() target that hasn't been loaded yet
+
+    static const int MaxCompletions = 50;
 };
 
 class LineNumberArea : public QWidget
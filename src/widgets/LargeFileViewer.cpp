@@ -0,0 +1,140 @@
+#include "LargeFileViewer.h"
+
+#include <QKeyEvent>
+#include <QMouseEvent>
+#include <QPainter>
+#include <QScrollBar>
+
+LargeFileViewer::LargeFileViewer(QWidget *parent)
+    : QAbstractScrollArea(parent)
+{
+    // Same font as CodeEditor
+    QFont font;
+    font.setFamily("Fira Code");
+    font.setStyleHint(QFont::Monospace);
+    font.setFixedPitch(true);
+    font.setPointSize(10);
+    setFont(font);
+
+    verticalScrollBar()->setSingleStep(1);
+    setFocusPolicy(Qt::StrongFocus);
+}
+
+bool LargeFileViewer::openFile(const QString &filePath)
+{
+    if (!index.open(filePath))
+        return false;
+    currentLine = -1;
+    updateScrollBars();
+    viewport()->update();
+    return true;
+}
+
+QString LargeFileViewer::errorString() const
+{
+    return index.errorString();
+}
+
+QString LargeFileViewer::filePath() const
+{
+    return index.filePath();
+}
+
+int LargeFileViewer::lineCount() const
+{
+    return index.lineCount();
+}
+
+void LargeFileViewer::goToLine(int lineNumber)
+{
+    currentLine = qBound(0, lineNumber - 1, qMax(0, index.lineCount() - 1));
+    verticalScrollBar()->setValue(currentLine - visibleLineCount() / 2);
+    viewport()->update();
+    setFocus();
+}
+
+void LargeFileViewer::paintEvent(QPaintEvent * /* event */)
+{
+    QPainter painter(viewport());
+    const QFontMetrics metrics = fontMetrics();
+    const int lineHeight = metrics.height();
+    const int gutter = lineNumberAreaWidth();
+    const int textLeft = gutter + 4 - horizontalScrollBar()->value();
+    const int height = viewport()->height();
+    const int width = viewport()->width();
+
+    painter.fillRect(0, 0, gutter, height, QColor("#21252b"));
+
+    int line = verticalScrollBar()->value();
+    for (int top = 0; top < height && line < index.lineCount(); top += lineHeight, ++line) {
+        if (line == currentLine)
+            painter.fillRect(gutter, top, width - gutter, lineHeight, QColor("#2c313a"));
+
+        painter.setClipping(false);
+        painter.setPen(QColor("#5C6370"));
+        painter.drawText(0, top, gutter - 3, lineHeight, Qt::AlignRight, QString::number(line + 1));
+
+        QString text = index.line(line, MaxDrawnBytes);
+        text.replace('\t', QLatin1String("    "));
+        painter.setClipRect(gutter, top, width - gutter, lineHeight);
+        painter.setPen(palette().color(QPalette::Text));
+        painter.drawText(textLeft, top + metrics.ascent(), text);
+    }
+}
+
+void LargeFileViewer::resizeEvent(QResizeEvent *event)
+{
+    QAbstractScrollArea::resizeEvent(event);
+    updateScrollBars();
+}
+
+void LargeFileViewer::keyPressEvent(QKeyEvent *event)
+{
+    if (event->matches(QKeySequence::MoveToStartOfDocument)) {
+        verticalScrollBar()->setValue(verticalScrollBar()->minimum());
+    } else if (event->matches(QKeySequence::MoveToEndOfDocument)) {
+        verticalScrollBar()->setValue(verticalScrollBar()->maximum());
+    } else {
+        // Arrows and page keys scroll
+        QAbstractScrollArea::keyPressEvent(event);
+    }
+}
+
+void LargeFileViewer::mousePressEvent(QMouseEvent *event)
+{
+    const int line = verticalScrollBar()->value() + int(event->position().y()) / fontMetrics().height();
+    if (line < index.lineCount()) {
+        currentLine = line;
+        viewport()->update();
+    }
+    QAbstractScrollArea::mousePressEvent(event);
+}
+
+void LargeFileViewer::updateScrollBars()
+{
+    const int visible = visibleLineCount();
+    verticalScrollBar()->setPageStep(visible);
+    verticalScrollBar()->setRange(0, qMax(0, index.lineCount() - visible));
+
+    const int textWidth = qMin(index.longestLine(), MaxDrawnBytes) * fontMetrics().horizontalAdvance(QLatin1Char('9'));
+    const int available = viewport()->width() - lineNumberAreaWidth() - 4;
+    horizontalScrollBar()->setPageStep(available);
+    horizontalScrollBar()->setSingleStep(fontMetrics().horizontalAdvance(QLatin1Char('9')) * 4);
+    horizontalScrollBar()->setRange(0, qMax(0, textWidth - available));
+}
+
+int LargeFileViewer::visibleLineCount() const
+{
+    return qMax(1, viewport()->height() / fontMetrics().height());
+}
+
+int LargeFileViewer::lineNumberAreaWidth() const
+{
+    int digits = 1;
+    int max = qMax(1, index.lineCount());
+    while (max >= 10) {
+        max /= 10;
+        ++digits;
+    }
+    return 6 + fontMetrics().horizontalAdvance(QLatin1Char('9')) * digits;
+}
@@ -0,0 +1,54 @@
+#ifndef INCODE_LARGEFILEVIEWER_H
+#define INCODE_LARGEFILEVIEWER_H
+
+#include <QAbstractScrollArea>
+#include "../LargeFileIndex.h"
+
+class QPaintEvent;
+class QResizeEvent;
+class QKeyEvent;
+class QMouseEvent;
+
+// Read-only viewer for files too large for CodeEditor (SQL dumps, logs).
+// Nothing is loaded into a document: each paint reads the visible lines
+// straight from the LargeFileIndex mapping, so scrolling and going to a
+// line cost the same at any file size.
+class LargeFileViewer : public QAbstractScrollArea
+{
+    Q_OBJECT
+
+public:
+    // Files at least this large open here instead of in a CodeEditor
+    static constexpr qint64 MinimumFileSize = qint64(16) << 20;
+
+    explicit LargeFileViewer(QWidget *parent = nullptr);
+
+    // Maps and indexes the file; on failure errorString() says why
+    bool openFile(const QString &filePath);
+    QString errorString() const;
+
+    QString filePath() const;
+    int lineCount() const;
+
+    // Scrolls a 1-based line to the middle of the view and marks it
+    void goToLine(int lineNumber);
+
+protected:
+    void paintEvent(QPaintEvent *event) override;
+    void resizeEvent(QResizeEvent *event) override;
+    void keyPressEvent(QKeyEvent *event) override;
+    void mousePressEvent(QMouseEvent *event) override;
+
+private:
+    // Longer lines are cut off when drawn (minified files are one line)
+    static const int MaxDrawnBytes = 4096;
+
+    void updateScrollBars();
+    int visibleLineCount() const;
+    int lineNumberAreaWidth() const;
+
+    LargeFileIndex index;
+    int currentLine = -1; // 0-based, -1 for none
+};
+
+#endif // INCODE_LARGEFILEVIEWER_H
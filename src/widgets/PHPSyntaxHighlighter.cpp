@@ -1,75 +1,171 @@
 #include "PHPSyntaxHighlighter.h"
-#include <QRegularExpression>
+#include "../LatencyProfiler.h"
+
+#include <QElapsedTimer>
+#include <QTextBlock>
+#include <QTextDocument>
+#include <QTimer>
+#include <limits>
 
 PHPSyntaxHighlighter::PHPSyntaxHighlighter(QTextDocument *parent)
-    : QSyntaxHighlighter(parent)
+    : QObject(parent), document(parent), sliceTimer(new QTimer(this))
+{
+    formats[PhpHighlightLexer::Keyword].setForeground(QColor("#C678DD"));
+    formats[PhpHighlightLexer::ClassName].setForeground(QColor("#E5C07B"));
+    formats[PhpHighlightLexer::Function].setForeground(QColor("#61AFEF"));
+    formats[PhpHighlightLexer::String].setForeground(QColor("#98C379"));
+    formats[PhpHighlightLexer::Comment].setForeground(QColor("#5C6370"));
+
+    sliceTimer->setSingleShot(true);
+    sliceTimer->setInterval(0);
+    connect(sliceTimer, &QTimer::timeout, this, &PHPSyntaxHighlighter::highlightSlice);
+    connect(document, &QTextDocument::contentsChange, this, &PHPSyntaxHighlighter::onContentsChange);
+
+    blockCount = document->blockCount();
+    scheduleSlice();
+}
+
+void PHPSyntaxHighlighter::highlightBlocks(int first, int last)
 {
-    HighlightingRule rule;
-
-    // Keywords
-    keywordFormat.setForeground(QColor("#C678DD"));
-    QStringList keywordPatterns;
-    keywordPatterns << "\b(abstract|and|array|as|break|callable|case|catch|class|clone|const|continue|declare|default|die|do|echo|else|elseif|empty|enddeclare|endfor|endforeach|endif|endswitch|endwhile|eval|exit|extends|final|for|foreach|function|global|goto|if|implements|include|include_once|instanceof|insteadof|interface|isset|list|namespace|new|or|print|private|protected|public|require|require_once|return|static|switch|throw|trait|try|unset|use|var|while|xor|yield)\b";
-    for (const QString &pattern : keywordPatterns) {
-        rule.pattern = QRegularExpression(pattern);
-        rule.format = keywordFormat;
-        highlightingRules.append(rule);
+    visibleLast = last;
+    last = qMin(last, blockCount - 1);
+    if (last < frontier)
+        return;
+
+    // Only the lexer state is needed up to the first block. States ahead of
+    // the frontier aren't stored, so the background pass can still tell
+    // which blocks settled after an edit.
+    QTextBlock block = document->findBlockByNumber(frontier);
+    int state = frontier > 0 ? block.previous().userState() : PhpHighlightLexer::InitialState;
+    int number = frontier;
+    for (; block.isValid() && number < first; block = block.next(), ++number) {
+        state = lexer.highlightLine(block.text(), state, spans);
+    }
+    for (; block.isValid() && number <= last; block = block.next(), ++number) {
+        state = highlightBlock(block, state);
     }
+    // Their formats no longer match the states stored before them, so the
+    // background pass mustn't skip the block after them as settled
+    lastChanged = qMax(lastChanged, number);
+}
 
-    // Classes
-    classFormat.setForeground(QColor("#E5C07B"));
-    rule.pattern = QRegularExpression("\b[A-Z][A-Za-z0-9_]+\b");
-    rule.format = classFormat;
-    highlightingRules.append(rule);
-
-    // Single-line comments
-    singleLineCommentFormat.setForeground(QColor("#5C6370"));
-    rule.pattern = QRegularExpression("//[^\n]*");
-    rule.format = singleLineCommentFormat;
-    highlightingRules.append(rule);
-
-    // Multi-line comments
-    multiLineCommentFormat.setForeground(QColor("#5C6370"));
-
-    // Quotation
-    quotationFormat.setForeground(QColor("#98C379"));
-    rule.pattern = QRegularExpression("(\"|\[quote]).*?\\1");
-    rule.format = quotationFormat;
-    highlightingRules.append(rule);
-
-    // Functions
-    functionFormat.setForeground(QColor("#61AFEF"));
-    rule.pattern = QRegularExpression("\b[A-Za-z0-9_]+(?=\\()\b");
-    rule.format = functionFormat;
-    highlightingRules.append(rule);
+void PHPSyntaxHighlighter::rehighlight()
+{
+    frontier = 0;
+    settledEnd = 0;
+    lastChanged = blockCount - 1;
+    advance(std::numeric_limits<qint64>::max());
 }
 
-void PHPSyntaxHighlighter::highlightBlock(const QString &text)
+bool PHPSyntaxHighlighter::isComplete() const
 {
-    for (const HighlightingRule &rule : highlightingRules) {
-        QRegularExpressionMatchIterator matchIterator = rule.pattern.globalMatch(text);
-        while (matchIterator.hasNext()) {
-            QRegularExpressionMatch match = matchIterator.next();
-            setFormat(match.capturedStart(), match.capturedLength(), rule.format);
-        }
+    return frontier >= blockCount;
+}
+
+void PHPSyntaxHighlighter::onContentsChange(int position, int /* charsRemoved */, int charsAdded)
+{
+    if (applyingFormats)
+        return;
+
+    const int count = document->blockCount();
+    const int delta = count - blockCount;
+    blockCount = count;
+    const int first = document->findBlock(position).blockNumber();
+    const QTextBlock lastBlock = document->findBlock(position + charsAdded);
+    const int last = lastBlock.isValid() ? lastBlock.blockNumber() : count - 1;
+
+    // Renumber for inserted or removed blocks; a marker inside the changed
+    // blocks moves just past them
+    const int oldLast = last - delta;
+    auto shifted = [=](int block) { return block > oldLast ? block + delta : qMin(block, last + 1); };
+    settledEnd = qMin(shifted(settledEnd), count);
+    lastChanged = qMax(shifted(lastChanged), last);
+    if (last > first || delta != 0) {
+        // Blocks were split or merged, so the block after the change was
+        // colored after a different block than now precedes it
+        lastChanged = qMax(lastChanged, last + 1);
     }
+    visibleLast = shifted(visibleLast);
 
-    setCurrentBlockState(0);
+    if (frontier >= first) {
+        settledEnd = qMin(qMax(settledEnd, shifted(frontier)), count);
+        frontier = first;
+        advance(qint64(EditBudgetMsecs) * 1000000);
+    } else {
+        // Edited ahead of the background pass: color what the editor shows
+        highlightBlocks(first, qMax(last, visibleLast));
+    }
+    scheduleSlice();
+}
 
-    int startIndex = 0;
-    if (previousBlockState() != 1)
-        startIndex = text.indexOf("/*");
+void PHPSyntaxHighlighter::highlightSlice()
+{
+    advance(qint64(SliceBudgetMsecs) * 1000000);
+    scheduleSlice();
+}
+
+void PHPSyntaxHighlighter::advance(qint64 budgetNsecs)
+{
+    QElapsedTimer timer;
+    timer.start();
 
-    while (startIndex >= 0) {
-        int endIndex = text.indexOf("*/", startIndex + 2);
-        int commentLength;
-        if (endIndex == -1) {
-            setCurrentBlockState(1);
-            commentLength = text.length() - startIndex;
+    QTextBlock block = document->findBlockByNumber(frontier);
+    int state = frontier > 0 ? block.previous().userState() : PhpHighlightLexer::InitialState;
+    while (block.isValid()) {
+        const int previous = block.userState();
+        state = highlightBlock(block, state);
+        block.setUserState(state);
+        ++frontier;
+
+        if (state == previous && frontier > lastChanged && frontier < settledEnd) {
+            // Everything up to settledEnd starts as it did before the edit
+            frontier = settledEnd;
+            block = document->findBlockByNumber(frontier);
+            state = block.previous().userState();
         } else {
-            commentLength = endIndex - startIndex + 2;
+            block = block.next();
+        }
+        if (timer.nsecsElapsed() >= budgetNsecs) {
+            // The next block hasn't been redone for this block's new state
+            if (state != previous)
+                lastChanged = qMax(lastChanged, frontier);
+            break;
         }
-        setFormat(startIndex, commentLength, multiLineCommentFormat);
-        startIndex = text.indexOf("/*", startIndex + commentLength);
     }
-}
\ No newline at end of file
+
+    if (isComplete()) {
+        settledEnd = 0;
+        lastChanged = -1;
+    }
+}
+
+int PHPSyntaxHighlighter::highlightBlock(const QTextBlock &block, int state)
+{
+    LatencyProfiler::Scope profile(LatencyProfiler::HighlightBlock);
+    state = lexer.highlightLine(block.text(), state, spans);
+
+    ranges.clear();
+    for (const PhpHighlightLexer::Span &span : std::as_const(spans)) {
+        QTextLayout::FormatRange range;
+        range.start = span.start;
+        range.length = span.length;
+        range.format = formats[span.category];
+        ranges.append(range);
+    }
+
+    // Unchanged blocks need no relayout, which is most of them after an edit
+    QTextLayout *layout = block.layout();
+    if (layout->formats() != ranges) {
+        layout->setFormats(ranges);
+        applyingFormats = true;
+        document->markContentsDirty(block.position(), block.length());
+        applyingFormats = false;
+    }
+    return state;
+}
+
+void PHPSyntaxHighlighter::scheduleSlice()
+{
+    if (!isComplete() && !sliceTimer->isActive())
+        sliceTimer->start();
+}
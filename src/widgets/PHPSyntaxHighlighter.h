@@ -1,34 +1,73 @@
 #ifndef PHPSYNTAXHIGHLIGHTER_H
 #define PHPSYNTAXHIGHLIGHTER_H
 
-#include <QSyntaxHighlighter>
+#include <QObject>
 #include <QTextCharFormat>
-#include <QRegularExpression>
+#include <QTextLayout>
+#include <QVector>
+#include "../PhpHighlightLexer.h"
 
-class PHPSyntaxHighlighter : public QSyntaxHighlighter
+class QTextBlock;
+class QTextDocument;
+class QTimer;
+
+// Colors PHP with PhpHighlightLexer without highlighting a whole document
+// before it can be shown, as QSyntaxHighlighter does on setPlainText.
+// Blocks are colored in order from a frontier that advances in short slices
+// on the event loop, and the editor has the blocks on screen colored ahead
+// of it. The lexer state each block ends in is kept as its user state, so
+// an edit only redoes blocks until that state stops changing.
+class PHPSyntaxHighlighter : public QObject
 {
     Q_OBJECT
 
 public:
-    PHPSyntaxHighlighter(QTextDocument *parent = nullptr);
+    explicit PHPSyntaxHighlighter(QTextDocument *parent);
+
+    // Colors blocks first..last (block numbers) now if the background pass
+    // hasn't reached them yet
+    void highlightBlocks(int first, int last);
+
+    // Colors the whole document before returning
+    void rehighlight();
+
+    // Whether the background pass has reached the end of the document
+    bool isComplete() const;
 
-protected:
-    void highlightBlock(const QString &text) override;
+private slots:
+    void onContentsChange(int position, int charsRemoved, int charsAdded);
+    void highlightSlice();
 
 private:
-    struct HighlightingRule
-    {
-        QRegularExpression pattern;
-        QTextCharFormat format;
-    };
-    QList<HighlightingRule> highlightingRules;
-
-    QTextCharFormat keywordFormat;
-    QTextCharFormat classFormat;
-    QTextCharFormat singleLineCommentFormat;
-    QTextCharFormat multiLineCommentFormat;
-    QTextCharFormat quotationFormat;
-    QTextCharFormat functionFormat;
+    // Synchronous work per edit (or load); the first screen fits easily
+    static const int EditBudgetMsecs = 8;
+    // Background work per event loop pass
+    static const int SliceBudgetMsecs = 4;
+
+    // Moves the frontier on until the end of the document or the budget
+    void advance(qint64 budgetNsecs);
+    // Lexes a block that starts in state and applies its formats; returns
+    // the state the next block starts in
+    int highlightBlock(const QTextBlock &block, int state);
+    void scheduleSlice();
+
+    QTextDocument *document;
+    QTimer *sliceTimer;
+    PhpHighlightLexer lexer;
+    QVector<PhpHighlightLexer::Span> spans; // reused for every block
+    QVector<QTextLayout::FormatRange> ranges; // likewise
+    QTextCharFormat formats[PhpHighlightLexer::CategoryCount];
+
+    // Blocks before the frontier are colored and their user state is the
+    // state they end in. Blocks from there up to settledEnd were colored
+    // before the latest edits and are still right if they come after
+    // lastChanged and the block before them ends in its old state.
+    int frontier = 0;
+    int settledEnd = 0;
+    int lastChanged = -1;
+    int blockCount = 0;
+    int visibleLast = 0; // last block the editor asked for
+    bool applyingFormats = false; // our own markContentsDirty calls
 };
 
 #endif // PHPSYNTAXHIGHLIGHTER_H